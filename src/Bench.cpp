@@ -0,0 +1,344 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <type_traits>
+
+#include "Polyhedra.hpp"
+#include "WriteToJSON.hpp"
+#include "SyntheticOBJ.hpp"
+
+
+
+// benchmarks of the conversion pipeline, the bimconvert_bench target in CMakeLists.txt
+// each stage runs Bench_Repeats times on a fresh copy of its input, the best time is kept
+// the Nef stages run for every kernel policy, the json stages (writing, text / CBOR / MessagePack encoding)
+// for the kernel chosen at build time; the results are written to bench.json in the output folder
+const int Bench_Repeats = 3;
+
+// synthetic inputs: storeys x rooms, see SyntheticOBJ
+const Synthetic_building Bench_Buildings[] = { Synthetic_building(1, 2), Synthetic_building(2, 4), Synthetic_building(4, 8) };
+
+const bool Bench_KIT = true; // also run on KIT.obj, after the synthetic inputs
+
+// scratch subfolder of the intermediate folder for the shells and the weld reports of the benchmark,
+// the <id>.obj shells of KIT.obj in the intermediate folder itself are part of the data
+const std::string Bench_Folder = "/bench";
+
+
+
+// one stage on one input with one kernel
+struct Bench_result {
+	std::string input;
+	std::string kernel;
+	std::string stage;
+	double seconds;
+	std::size_t vertices; // vertices processed by the stage
+	std::size_t faces;    // faces processed by the stage
+};
+
+
+// discard std::cout of the pipeline while a stage is timed
+class Quiet_cout {
+private:
+	std::streambuf* buffer;
+public:
+	Quiet_cout() : buffer(std::cout.rdbuf(nullptr)) {}
+	~Quiet_cout() {
+		std::cout.rdbuf(buffer);
+		std::cout.clear();
+	}
+};
+
+
+class Bench {
+private:
+	/*
+	* best time of Bench_Repeats runs, setup (untimed) prepares the input of each run
+	*/
+	static double best_time(const std::function<void()>& setup, const std::function<void()>& job) {
+		double best = std::numeric_limits<double>::max();
+		for (int run = 0; run != Bench_Repeats; ++run) {
+			setup();
+			Quiet_cout quiet;
+			auto start = std::chrono::steady_clock::now();
+			job();
+			best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+		}
+		return best;
+	}
+
+
+	static void add(std::vector<Bench_result>& results, const std::string& input, const std::string& kernel,
+		const std::string& stage, double seconds, std::size_t vertices, std::size_t faces) {
+		results.push_back({ input, kernel, stage, seconds, vertices, faces });
+		const Bench_result& r = results.back();
+		std::cout << std::left << std::setw(22) << r.kernel.substr(0, 21) << std::setw(24) << r.stage
+			<< std::right << std::setw(12) << std::fixed << std::setprecision(4) << r.seconds << " s"
+			<< std::setw(14) << std::setprecision(0) << per_second(r.vertices, r.seconds) << " v/s"
+			<< std::setw(14) << per_second(r.faces, r.seconds) << " f/s" << '\n';
+		std::cout.unsetf(std::ios::floatfield);
+		std::cout << std::setprecision(6);
+	}
+
+
+	static double per_second(std::size_t count, double seconds) {
+		return seconds > 0 ? (double)count / seconds : 0.0;
+	}
+
+
+	/*
+	* the union of the Nef polyhedra as a balanced tree of pairwise unions,
+	* the operands stay small for longer than in the linear union of BigNef::test_big
+	*/
+	template <class P>
+	static typename P::Nef_polyhedron union_tree(std::vector<typename P::Nef_polyhedron> list) {
+		typedef typename P::Nef_polyhedron Nef_polyhedron;
+		if (list.empty()) return Nef_polyhedron(Nef_polyhedron::EMPTY);
+		while (list.size() > 1) {
+			std::vector<Nef_polyhedron> next;
+			for (std::size_t i = 0; i + 1 < list.size(); i += 2) next.push_back(list[i] + list[i + 1]);
+			if (list.size() % 2 == 1) next.push_back(list.back());
+			list.swap(next);
+		}
+		return list[0];
+	}
+
+
+	template <class P>
+	static std::pair<std::size_t, std::size_t> explorer_size(const std::vector<Shell_explorer<P>>& shell_explorers) {
+		std::size_t num_vertices = 0, num_faces = 0;
+		for (auto const& se : shell_explorers) {
+			num_vertices += se.vertices.size();
+			num_faces += se.faces.size();
+		}
+		return std::make_pair(num_vertices, num_faces);
+	}
+public:
+
+	/*
+	* parse, weld and prepare fname as main does, f keeps the result of the last run
+	* the shells are written to <id>.obj in Bench_Folder for the Nef stages
+	*/
+	static void bench_obj(const std::string& input, std::string fname, OBJFile& f, std::vector<Bench_result>& results) {
+		std::string repeated_vertices_name = Bench_Folder + "/repeated.vertices.txt";
+		std::string repeated_faces_name = Bench_Folder + "/repeated.faces.txt";
+		std::string new_vertices_name = Bench_Folder + "/new.vertices.txt";
+		std::string new_faces_name = Bench_Folder + "/new.faces.txt";
+
+		double seconds = best_time([&]() { f = OBJFile(); }, [&]() { LoadOBJ::load_obj(fname, f); });
+		add(results, input, "-", "parse", seconds, f.vertices.size(), f.faces.size());
+		OBJFile parsed = f;
+
+		seconds = best_time([&]() { f = parsed; }, [&]() {
+			LoadOBJ::repeated_vertices_info(repeated_vertices_name, f);
+			LoadOBJ::repeated_faces_info(repeated_faces_name, f);
+			LoadOBJ::process_repeated_vertices(new_vertices_name, f);
+			LoadOBJ::process_repeated_faces(new_faces_name, f);
+			if (Snap_Enabled) SnapRounding::snap_vertices(f);
+		});
+		add(results, input, "-", "weld", seconds, parsed.vertices.size(), parsed.faces.size());
+		OBJFile welded = f;
+
+		seconds = best_time([&]() { f = welded; }, [&]() { PreparePolyhedron::prepare_poly_vertices_face_indices(f); });
+		add(results, input, "-", "prep", seconds, f.new_vertices.size(), f.faces.size());
+
+		Quiet_cout quiet;
+		PreparePolyhedron::output_each_shell(f, Bench_Folder);
+	}
+
+
+	/*
+	* Nef stages of one kernel on the shells written by bench_obj
+	* kit: build the Nef polyhedra as main does for KIT.obj, otherwise each shell by the polyhedron builder
+	*/
+	template <class P>
+	static void bench_kernel(const std::string& input, bool kit, const OBJFile& f, std::vector<Bench_result>& results) {
+		typedef typename P::Nef_polyhedron Nef_polyhedron;
+		std::string kernel = P::name();
+		int shell_count = (int)f.shells.size();
+
+		std::size_t shell_vertices = 0, shell_faces = 0;
+		for (auto const& obj : f.objects) {
+			for (auto const& shell : obj.shells) {
+				shell_vertices += shell.poly_vertices.size();
+				shell_faces += shell.faces.size();
+			}
+		}
+
+		// builder and hull of every shell, whether or not main builds it this way
+		for (bool convex_hull : { false, true }) {
+			double seconds = best_time([]() {}, [&]() {
+				typename Build_Nef_Polyhedron<P>::Template_cache cache;
+				for (int shell_id = 1; shell_id <= shell_count; ++shell_id) {
+					Build_Nef_Polyhedron<P>::build_shell(shell_id, convex_hull, nullptr, cache, false, Bench_Folder);
+				}
+			});
+			add(results, input, kernel, convex_hull ? "nef.hull" : "nef.builder", seconds, shell_vertices, shell_faces);
+		}
+
+		Nef<P> built;
+		{
+			Quiet_cout quiet;
+			if (kit) Build_Nef_Polyhedron<P>::build_nef_polyhedra(built, nullptr, Bench_Folder);
+			else Build_Nef_Polyhedron<P>::build_nef_polyhedra_each_shell(built, shell_count, nullptr, Bench_Folder);
+		}
+		std::size_t nef_vertices = 0, nef_facets = 0;
+		for (auto const& nef_poly : built.nef_polyhedron_list) {
+			nef_vertices += nef_poly.number_of_vertices();
+			nef_facets += nef_poly.number_of_facets();
+		}
+
+		Nef<P> nef;
+		double seconds = best_time([&]() { nef = built; }, [&]() { BigNef<P>::test_big(nef); });
+		add(results, input, kernel, "union.linear", seconds, nef_vertices, nef_facets);
+
+		Nef_polyhedron tree;
+		seconds = best_time([]() {}, [&]() { tree = union_tree<P>(built.nef_polyhedron_list); });
+		add(results, input, kernel, "union.tree", seconds, nef_vertices, nef_facets);
+		if (tree.number_of_vertices() != nef.big_nef.number_of_vertices() || tree.number_of_volumes() != nef.big_nef.number_of_volumes()) {
+			std::cout << "warning: the linear and the tree union differ" << '\n';
+		}
+
+		{
+			Quiet_cout quiet;
+			BigNef<P>::regularize(nef);
+		}
+		std::size_t big_vertices = nef.big_nef.number_of_vertices(), big_facets = nef.big_nef.number_of_facets();
+
+		std::vector<Shell_explorer<P>> shell_explorers;
+		seconds = best_time([&]() { shell_explorers.clear(); }, [&]() { ExtractGeometries<P>::extract_visitor(nef, shell_explorers); });
+		add(results, input, kernel, "extract.visitor", seconds, big_vertices, big_facets);
+
+		std::vector<Shell_explorer<P>> mesh_explorers;
+		seconds = best_time([&]() { mesh_explorers.clear(); }, [&]() { ExtractGeometries<P>::extract_surface_mesh(nef, mesh_explorers); });
+		add(results, input, kernel, "extract.surface_mesh", seconds, big_vertices, big_facets);
+
+		bench_json<P>(input, shell_explorers, results);
+	}
+
+
+	/*
+	* WriteToJSON works on the shells of the kernel chosen at build time
+	*/
+	template <class P>
+	static void bench_json(const std::string& input, std::vector<Shell_explorer<P>>& shell_explorers, std::vector<Bench_result>& results) {
+		if constexpr (std::is_same<P, Policy>::value) {
+			std::string fname = "/bench.city.json";
+			std::pair<std::size_t, std::size_t> size = explorer_size<P>(shell_explorers);
+			double seconds = best_time([]() {}, [&]() {
+				WriteToJSON w;
+				w.process_shell_explorer_indices(shell_explorers);
+				w.write_vertices_shells(fname);
+			});
+			add(results, input, P::name(), "json.write", seconds, size.first, size.second);
+			std::remove((OUTPUT_PATH + fname).c_str());
+
+			nlohmann::json document;
+			{
+				Quiet_cout quiet;
+				WriteToJSON w;
+				w.process_shell_explorer_indices(shell_explorers);
+				document = w.to_json();
+			}
+			bench_formats(input, P::name(), document, size, results);
+		}
+	}
+
+
+	/*
+	* encode and decode the document as compact text, CBOR and MessagePack, and compare their sizes
+	*/
+	static void bench_formats(const std::string& input, const std::string& kernel, const nlohmann::json& document,
+		std::pair<std::size_t, std::size_t> size, std::vector<Bench_result>& results) {
+		std::string text;
+		double seconds = best_time([]() {}, [&]() { text = document.dump(); });
+		add(results, input, kernel, "json.text.encode", seconds, size.first, size.second);
+		nlohmann::json decoded;
+		seconds = best_time([]() {}, [&]() { decoded = nlohmann::json::parse(text); });
+		add(results, input, kernel, "json.text.decode", seconds, size.first, size.second);
+		std::ostringstream sizes;
+		sizes << "   text: " << text.size() << " bytes";
+
+		for (Binary_Format format : { Binary_Format::CBOR, Binary_Format::MSGPACK }) {
+			std::string name = format == Binary_Format::CBOR ? "cbor" : "msgpack";
+			std::vector<std::uint8_t> bytes;
+			seconds = best_time([]() {}, [&]() { bytes = WriteToJSON::encode(document, format); });
+			add(results, input, kernel, "json." + name + ".encode", seconds, size.first, size.second);
+			seconds = best_time([]() {}, [&]() { decoded = WriteToJSON::decode(bytes, format); });
+			add(results, input, kernel, "json." + name + ".decode", seconds, size.first, size.second);
+			if (decoded != document) std::cout << "warning: the " << name << " round trip differs" << '\n';
+			sizes << ", " << name << ": " << bytes.size() << " bytes";
+		}
+		std::cout << sizes.str() << '\n';
+	}
+
+
+	/*
+	* all stages of one input, for every kernel
+	*/
+	static void bench_input(const std::string& input, const std::string& fname, bool kit, std::vector<Bench_result>& results) {
+		std::cout << '\n' << "-- " << input << '\n';
+		OBJFile f;
+		bench_obj(input, fname, f, results);
+		std::cout << "   " << f.new_vertices.size() << " vertices, " << f.faces.size() << " faces, " << f.shells.size() << " shells" << '\n';
+		bench_kernel<Epeck_policy>(input, kit, f, results);
+		bench_kernel<Cartesian_rational_policy>(input, kit, f, results);
+		bench_kernel<Homogeneous_integer_policy>(input, kit, f, results);
+	}
+
+
+	static void write_results(const std::string& fname, const std::vector<Bench_result>& results) {
+		nlohmann::json json = nlohmann::json::array();
+		for (auto const& r : results) {
+			json.push_back({
+				{ "input", r.input }, { "kernel", r.kernel }, { "stage", r.stage }, { "seconds", r.seconds },
+				{ "vertices", r.vertices }, { "faces", r.faces },
+				{ "vertices_per_second", per_second(r.vertices, r.seconds) }, { "faces_per_second", per_second(r.faces, r.seconds) } });
+		}
+		std::string filename = OUTPUT_PATH + fname;
+		std::ofstream out(filename);
+		if (!out.is_open()) {
+			std::cout << "warning: can not open " << filename << '\n';
+			return;
+		}
+		out << json.dump(2) << '\n';
+		std::cout << '\n' << "benchmark results stored in: " << filename << '\n';
+	}
+};
+
+
+
+int main()
+{
+	std::cout << "-- benchmark, best of " << Bench_Repeats << " runs, snap rounding: " << (Snap_Enabled ? "on" : "off") << '\n';
+	std::cout << "kernel, stage, best time, throughput in vertices and faces per second" << '\n';
+	std::vector<Bench_result> results;
+
+	for (auto const& building : Bench_Buildings) {
+		std::ostringstream name;
+		name << "synthetic " << building.storeys << "x" << building.rooms;
+		std::string fname = "/bench.synthetic.obj";
+		std::size_t shell_count;
+		{
+			Quiet_cout quiet;
+			shell_count = SyntheticOBJ::write(fname, building);
+		}
+		if (shell_count == 0) continue;
+		Bench::bench_input(name.str(), fname, false, results);
+		std::remove((INPUT_PATH + fname).c_str());
+
+		// clear the scratch shells, the next input writes its own
+		for (std::size_t shell_id = 1; shell_id <= shell_count; ++shell_id) {
+			std::remove((INTER_PATH + (Bench_Folder + "/" + std::to_string(shell_id) + ".obj")).c_str());
+		}
+	}
+
+	if (Bench_KIT) Bench::bench_input("KIT.obj", "/KIT.obj", true, results);
+
+	Bench::write_results("/bench.json", results);
+	return 0;
+}
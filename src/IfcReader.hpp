@@ -0,0 +1,1849 @@
+#pragma once
+
+#include "LoadOBJ.hpp"
+#include "Polyhedra.hpp"
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// products whose body geometry is loaded from an ifc file, the building elements IfcConvert writes to KIT.obj
+const std::vector<std::string> Ifc_Element_Types = {
+	"IFCWALL", "IFCWALLSTANDARDCASE", "IFCSLAB", "IFCWINDOW", "IFCDOOR"
+};
+
+// extruded products (IfcExtrudedAreaSolid, possibly clipped by half spaces) are built as Nef polyhedra directly
+// from their profiles, with the decimal numbers of the file as exact coordinates -- see Build_Nef_Extrusion
+// their openings (IfcRelVoidsElement) are subtracted if the openings are extruded as well
+// other products are loaded as faces into the obj file structures, without subtracting their openings
+const bool Ifc_Extrusion_Fast_Path = true;
+const double Ifc_Axis_Tolerance = 1e-9; // placement entries this close to an integer are taken as that integer, ie cos(90) = 6.1e-17 -> 0
+
+// the data section is indexed in parallel, one chunk per thread, in chunks of at least this many bytes
+const std::size_t Ifc_Scan_Chunk = 1 << 20;
+
+
+
+/*
+* read only view of a whole file, memory mapped
+* if the file cannot be mapped (ie an empty file) its contents are read into memory instead
+*/
+class Mapped_file {
+private:
+	const char* begin_;
+	std::size_t size_;
+	std::string contents; // fallback, the file read with std::ifstream
+#ifdef _WIN32
+	HANDLE file_handle;
+	HANDLE mapping_handle;
+#else
+	int file_descriptor;
+#endif
+
+	bool map(const std::string& filename) {
+#ifdef _WIN32
+		file_handle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file_handle == INVALID_HANDLE_VALUE) return false;
+		LARGE_INTEGER file_size;
+		if (!GetFileSizeEx(file_handle, &file_size) || file_size.QuadPart == 0) return false;
+		mapping_handle = CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping_handle == nullptr) return false;
+		const void* view = MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+		if (view == nullptr) return false;
+		begin_ = static_cast<const char*>(view);
+		size_ = (std::size_t)file_size.QuadPart;
+		return true;
+#else
+		file_descriptor = ::open(filename.c_str(), O_RDONLY);
+		if (file_descriptor < 0) return false;
+		struct stat file_status;
+		if (::fstat(file_descriptor, &file_status) != 0 || file_status.st_size == 0) return false;
+		void* view = ::mmap(nullptr, (std::size_t)file_status.st_size, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+		if (view == MAP_FAILED) return false;
+		::madvise(view, (std::size_t)file_status.st_size, MADV_SEQUENTIAL);
+		begin_ = static_cast<const char*>(view);
+		size_ = (std::size_t)file_status.st_size;
+		return true;
+#endif
+	}
+public:
+	Mapped_file() :
+		begin_(nullptr), size_(0)
+#ifdef _WIN32
+		, file_handle(INVALID_HANDLE_VALUE), mapping_handle(nullptr)
+#else
+		, file_descriptor(-1)
+#endif
+	{}
+
+	Mapped_file(const Mapped_file&) = delete;
+	Mapped_file& operator=(const Mapped_file&) = delete;
+
+	~Mapped_file() {
+		close();
+	}
+
+
+	/*
+	* return: False - the file cannot be read
+	*/
+	bool open(const std::string& filename) {
+		close();
+		if (map(filename)) return true;
+		close();
+
+		std::ifstream file(filename, std::ios::binary);
+		if (!file.is_open()) return false;
+		contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		begin_ = contents.data();
+		size_ = contents.size();
+		return true;
+	}
+
+
+	void close() {
+		bool mapped = begin_ != nullptr && begin_ != contents.data();
+#ifdef _WIN32
+		if (mapped) UnmapViewOfFile(begin_);
+		if (mapping_handle != nullptr) CloseHandle(mapping_handle);
+		if (file_handle != INVALID_HANDLE_VALUE) CloseHandle(file_handle);
+		mapping_handle = nullptr;
+		file_handle = INVALID_HANDLE_VALUE;
+#else
+		if (mapped) ::munmap(const_cast<char*>(begin_), size_);
+		if (file_descriptor >= 0) ::close(file_descriptor);
+		file_descriptor = -1;
+#endif
+		contents.clear();
+		begin_ = nullptr;
+		size_ = 0;
+	}
+
+
+	const char* begin() const { return begin_; }
+	const char* end() const { return begin_ + size_; }
+	std::size_t size() const { return size_; }
+};
+
+
+// attribute value of an entity instance
+struct Ifc_value {
+	enum Kind {
+		NONE, // $, attribute not set
+		DERIVED, // *, attribute derived by a subtype
+		INTEGER,
+		REAL,
+		STRING,
+		ENUMERATION, // .ELEMENT. -- text without the dots
+		BINARY,
+		REFERENCE, // #id
+		LIST, // (...) -- items in list
+		TYPED // IFCLABEL('x') -- type name in text, the value is list[0]
+	};
+
+	Kind kind;
+	double number; // INTEGER, REAL
+	unsigned long ref; // REFERENCE
+	std::string_view token; // INTEGER, REAL: the number as written in the file, valid while the file is open
+	std::string text; // STRING (decoded to utf-8), ENUMERATION, BINARY, name of a TYPED value
+	std::vector<Ifc_value> list;
+
+	Ifc_value() :
+		kind(NONE), number(0), ref(0) {}
+
+	bool is_null() const { return kind == NONE || kind == DERIVED; }
+	bool is_number() const { return kind == INTEGER || kind == REAL || (kind == TYPED && !list.empty() && list[0].is_number()); }
+	bool is_reference() const { return kind == REFERENCE; }
+
+	double real() const { return kind == TYPED && !list.empty() ? list[0].real() : number; }
+	bool boolean() const { return kind == ENUMERATION && text == "T"; }
+};
+
+
+// decoded entity instance: #id=TYPE(arguments);
+struct Ifc_entity {
+	unsigned long id;
+	std::string type; // upper case, ie IFCWALLSTANDARDCASE
+	std::vector<Ifc_value> arguments;
+
+	Ifc_entity() :
+		id(0) {}
+
+	const Ifc_value& operator[](std::size_t i) const {
+		static const Ifc_value none;
+		return i < arguments.size() ? arguments[i] : none;
+	}
+};
+
+
+
+/*
+* streaming reader of an ifc step physical file (ISO 10303-21)
+* open() maps the file and scans it once, recording the id, type hash and position of each #id=TYPE(...); record,
+* the arguments of a record are only parsed when the entity is first requested (entity(id)), references are followed on demand
+* load(types) decodes the entities of some types and everything they refer to in parallel beforehand,
+* so the work after the scan depends on the exported subset and not on the size of the file
+* the entities stay cached until the file is closed, entity() is not thread safe
+*/
+class IfcFile {
+private:
+	// position of one record in the mapped file
+	struct Record {
+		unsigned long id;
+		std::uint32_t type_hash; // type_hash() of the type name
+		std::size_t type_begin; // offset of the type name
+		std::size_t type_length; // 0 for a complex entity instance #id=(A(...)B(...));
+		std::size_t end; // offset of the closing ';'
+	};
+
+	Mapped_file file;
+	std::string schema_;
+	std::vector<Record> records; // in file order
+	std::unordered_map<unsigned long, std::size_t> index; // id -> position in records
+	mutable std::vector<std::unique_ptr<Ifc_entity>> entities; // decoded records, parallel to records
+	std::size_t index_threads; // threads used by the scan in open()
+
+	static bool is_space(char c) {
+		return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+	}
+
+
+	static bool is_keyword_char(char c) {
+		return std::isalnum((unsigned char)c) || c == '_' || c == '-';
+	}
+
+
+	/*
+	* FNV-1a hash of a type name, case insensitive
+	*/
+	static std::uint32_t type_hash(const char* name, std::size_t length) {
+		std::uint32_t hash = 2166136261u;
+		for (std::size_t k = 0; k != length; ++k) {
+			hash ^= (std::uint32_t)std::toupper((unsigned char)name[k]);
+			hash *= 16777619u;
+		}
+		return hash;
+	}
+
+
+	/*
+	* type name of a record equals an upper case name
+	*/
+	bool has_type(const Record& record, std::uint32_t hash, const std::string& type_name) const {
+		if (record.type_hash != hash || record.type_length != type_name.size()) return false;
+		const char* type = file.begin() + record.type_begin;
+		for (std::size_t k = 0; k != record.type_length; ++k) {
+			if (std::toupper((unsigned char)type[k]) != type_name[k]) return false;
+		}
+		return true;
+	}
+
+
+	/*
+	* skip white space and comments
+	*/
+	static const char* skip_space(const char* p, const char* end) {
+		while (p != end) {
+			if (is_space(*p)) ++p;
+			else if (*p == '/' && p + 1 != end && p[1] == '*') {
+				const char* close = p + 2;
+				while (close + 1 < end && !(close[0] == '*' && close[1] == '/')) ++close;
+				p = close + 1 < end ? close + 2 : end;
+			}
+			else break;
+		}
+		return p;
+	}
+
+
+	/*
+	* closing quote of the string opening at p, quotes inside the string are doubled
+	*/
+	static const char* string_end(const char* p, const char* end) {
+		for (++p; p != end; ++p) {
+			if (*p != '\'') continue;
+			if (p + 1 != end && p[1] == '\'') ++p;
+			else return p;
+		}
+		return nullptr;
+	}
+
+
+	/*
+	* the ';' ending the statement starting at p, skipping strings and comments
+	*/
+	static const char* statement_end(const char* p, const char* end) {
+		while (p != end) {
+			char c = *p;
+			if (c == ';') return p;
+			if (c == '\'') {
+				p = string_end(p, end);
+				if (p == nullptr) return nullptr;
+			}
+			else if (c == '/' && p + 1 != end && p[1] == '*') {
+				p = skip_space(p, end);
+				continue;
+			}
+			++p;
+		}
+		return nullptr;
+	}
+
+
+	static void append_utf8(std::string& s, unsigned long c) {
+		if (c < 0x80) s.push_back((char)c);
+		else if (c < 0x800) {
+			s.push_back((char)(0xC0 | (c >> 6)));
+			s.push_back((char)(0x80 | (c & 0x3F)));
+		}
+		else if (c < 0x10000) {
+			s.push_back((char)(0xE0 | (c >> 12)));
+			s.push_back((char)(0x80 | ((c >> 6) & 0x3F)));
+			s.push_back((char)(0x80 | (c & 0x3F)));
+		}
+		else {
+			s.push_back((char)(0xF0 | (c >> 18)));
+			s.push_back((char)(0x80 | ((c >> 12) & 0x3F)));
+			s.push_back((char)(0x80 | ((c >> 6) & 0x3F)));
+			s.push_back((char)(0x80 | (c & 0x3F)));
+		}
+	}
+
+
+	static unsigned long hex_value(std::string_view s) {
+		unsigned long value = 0;
+		std::from_chars(s.data(), s.data() + s.size(), value, 16);
+		return value;
+	}
+
+
+	/*
+	* decode the text between the quotes of a string to utf-8:
+	* '' -> ', \\ -> \, \S\c -> c + 128 (ISO 8859-1), \X\hh, \X2\hhhh...\X0\, \X4\hhhhhhhh...\X0\, page switches \P?\ are ignored
+	*/
+	static std::string decode_string(std::string_view raw) {
+		std::string s;
+		s.reserve(raw.size());
+		std::size_t i = 0, n = raw.size();
+		while (i < n) {
+			char c = raw[i];
+			if (c == '\'' && i + 1 < n && raw[i + 1] == '\'') {
+				s.push_back('\'');
+				i += 2;
+			}
+			else if (c != '\\' || i + 1 >= n) {
+				s.push_back(c);
+				++i;
+			}
+			else if (raw[i + 1] == '\\') {
+				s.push_back('\\');
+				i += 2;
+			}
+			else if (raw.compare(i, 3, "\\S\\") == 0 && i + 3 < n) {
+				append_utf8(s, (unsigned char)raw[i + 3] + 128u);
+				i += 4;
+			}
+			else if (raw.compare(i, 3, "\\X\\") == 0 && i + 5 <= n) {
+				append_utf8(s, hex_value(raw.substr(i + 3, 2)));
+				i += 5;
+			}
+			else if (raw.compare(i, 4, "\\X2\\") == 0 || raw.compare(i, 4, "\\X4\\") == 0) {
+				std::size_t digits = raw[i + 2] == '2' ? 4 : 8;
+				std::size_t close = raw.find("\\X0\\", i + 4);
+				if (close == std::string_view::npos) close = n;
+				for (std::size_t k = i + 4; k + digits <= close; k += digits) {
+					append_utf8(s, hex_value(raw.substr(k, digits)));
+				}
+				i = close == n ? n : close + 4;
+			}
+			else if (raw[i + 1] == 'P' && i + 3 < n && raw[i + 3] == '\\') {
+				i += 4;
+			}
+			else {
+				s.push_back(c);
+				++i;
+			}
+		}
+		return s;
+	}
+
+
+	/*
+	* parse the value starting at p, return the position after it or nullptr on a syntax error
+	*/
+	static const char* parse_value(const char* p, const char* end, Ifc_value& v) {
+		p = skip_space(p, end);
+		if (p == end) return nullptr;
+		char c = *p;
+
+		if (c == '$' || c == '*') {
+			v.kind = c == '$' ? Ifc_value::NONE : Ifc_value::DERIVED;
+			return p + 1;
+		}
+		if (c == '#') {
+			auto result = std::from_chars(p + 1, end, v.ref);
+			if (result.ec != std::errc()) return nullptr;
+			v.kind = Ifc_value::REFERENCE;
+			return result.ptr;
+		}
+		if (c == '\'') {
+			const char* close = string_end(p, end);
+			if (close == nullptr) return nullptr;
+			v.kind = Ifc_value::STRING;
+			v.text = decode_string(std::string_view(p + 1, (std::size_t)(close - p - 1)));
+			return close + 1;
+		}
+		if (c == '.' || c == '"') {
+			const char* close = static_cast<const char*>(std::memchr(p + 1, c, (std::size_t)(end - p - 1)));
+			if (close == nullptr) return nullptr;
+			v.kind = c == '.' ? Ifc_value::ENUMERATION : Ifc_value::BINARY;
+			v.text.assign(p + 1, close);
+			return close + 1;
+		}
+		if (c == '(') {
+			v.kind = Ifc_value::LIST;
+			return parse_list(p, end, v.list);
+		}
+		if (c == '-' || c == '+' || std::isdigit((unsigned char)c)) {
+			const char* q = p + 1;
+			bool is_real = false;
+			while (q != end && (std::isdigit((unsigned char)*q) || *q == '.' || *q == 'E' || *q == 'e' || *q == '-' || *q == '+')) {
+				if (*q == '.' || *q == 'E' || *q == 'e') is_real = true;
+				++q;
+			}
+			char number[64];
+			std::size_t length = std::min<std::size_t>((std::size_t)(q - p), sizeof(number) - 1);
+			std::memcpy(number, p, length);
+			number[length] = '\0';
+			v.kind = is_real ? Ifc_value::REAL : Ifc_value::INTEGER;
+			v.number = std::strtod(number, nullptr);
+			v.token = std::string_view(p, (std::size_t)(q - p));
+			return q;
+		}
+		if (std::isalpha((unsigned char)c)) {
+			const char* q = p;
+			while (q != end && is_keyword_char(*q)) ++q;
+			v.kind = Ifc_value::TYPED;
+			v.text.assign(p, q);
+			for (auto& ch : v.text) ch = (char)std::toupper((unsigned char)ch);
+			q = skip_space(q, end);
+			if (q == end || *q != '(') return nullptr;
+			return parse_list(q, end, v.list);
+		}
+		return nullptr;
+	}
+
+
+	/*
+	* parse the list opening at p, return the position after the closing parenthesis
+	*/
+	static const char* parse_list(const char* p, const char* end, std::vector<Ifc_value>& list) {
+		p = skip_space(p + 1, end);
+		if (p != end && *p == ')') return p + 1;
+		while (p != nullptr && p != end) {
+			list.emplace_back();
+			p = parse_value(p, end, list.back());
+			if (p == nullptr) return nullptr;
+			p = skip_space(p, end);
+			if (p == end) return nullptr;
+			if (*p == ')') return p + 1;
+			if (*p != ',') return nullptr;
+			++p;
+		}
+		return nullptr;
+	}
+
+
+	/*
+	* header section: FILE_SCHEMA and the start of the data section
+	* return: the position after DATA; or nullptr
+	*/
+	const char* read_header(const char* p, const char* end) {
+		while ((p = skip_space(p, end)) != end) {
+			const char* keyword_end = p;
+			while (keyword_end != end && is_keyword_char(*keyword_end)) ++keyword_end;
+			std::string_view keyword(p, (std::size_t)(keyword_end - p));
+			const char* statement = statement_end(p, end);
+			if (statement == nullptr) return nullptr;
+
+			if (keyword == "DATA") return statement + 1;
+			if (keyword == "FILE_SCHEMA") {
+				Ifc_value schemas;
+				const char* arguments = skip_space(keyword_end, end);
+				if (arguments != end && *arguments == '(' && parse_list(arguments, end, schemas.list) != nullptr &&
+					!schemas.list.empty() && !schemas.list[0].list.empty()) {
+					schema_ = schemas.list[0].list[0].text;
+				}
+			}
+			p = statement + 1;
+		}
+		return nullptr;
+	}
+
+
+	/*
+	* record the position of each #id=TYPE(...); starting in [p, limit), up to the end of the data section
+	* return: the position after the last record, ie limit if the next record starts there
+	*/
+	const char* scan(const char* p, const char* end, const char* limit, std::vector<Record>& out) const {
+		const char* begin = file.begin();
+		while ((p = skip_space(p, end)) < limit && *p == '#') {
+			Record record;
+			auto result = std::from_chars(p + 1, end, record.id);
+			const char* q = skip_space(result.ptr, end);
+			if (result.ec != std::errc() || q == end || *q != '=') break;
+
+			q = skip_space(q + 1, end);
+			const char* type_end = q;
+			while (type_end != end && is_keyword_char(*type_end)) ++type_end;
+			const char* statement = statement_end(type_end, end);
+			if (statement == nullptr) break;
+
+			record.type_hash = type_hash(q, (std::size_t)(type_end - q));
+			record.type_begin = (std::size_t)(q - begin);
+			record.type_length = (std::size_t)(type_end - q);
+			record.end = (std::size_t)(statement - begin);
+			out.push_back(record);
+			p = statement + 1;
+		}
+		return p;
+	}
+
+
+	/*
+	* index the data section starting at p, with one chunk per thread
+	* each chunk after the first starts at the first record beginning a line past its share of the file,
+	* it is only kept if the previous chunk ended exactly there, otherwise (ie the start was inside a
+	* multi line string) the rest of the file is scanned again sequentially
+	* return: the number of threads used
+	*/
+	std::size_t index_records(const char* p, const char* end) {
+		std::size_t num_chunks = std::max<std::size_t>(1, std::min<std::size_t>(
+			std::thread::hardware_concurrency(), (std::size_t)(end - p) / Ifc_Scan_Chunk));
+
+		std::vector<const char*> starts(num_chunks + 1, end);
+		starts[0] = p;
+		for (std::size_t k = 1; k < num_chunks; ++k) {
+			const char* q = std::max(starts[k - 1], p + (std::size_t)(end - p) / num_chunks * k);
+			while (q != end && !(*q == '#' && q[-1] == '\n')) {
+				const char* line = static_cast<const char*>(std::memchr(q, '\n', (std::size_t)(end - q)));
+				q = line == nullptr ? end : line + 1;
+			}
+			starts[k] = q;
+		}
+
+		std::vector<std::vector<Record>> chunks(num_chunks);
+		std::vector<const char*> stops(num_chunks);
+		std::size_t num_threads = parallel_for(num_chunks, [&](std::size_t k) {
+			stops[k] = scan(starts[k], end, starts[k + 1], chunks[k]);
+		});
+
+		records.clear();
+		for (std::size_t k = 0; k != num_chunks; ++k) {
+			records.insert(records.end(), chunks[k].begin(), chunks[k].end());
+			if (k + 1 == num_chunks || stops[k] < starts[k + 1]) break; // end of the data section
+			if (stops[k] > starts[k + 1]) {
+				scan(stops[k], end, end, records);
+				break;
+			}
+		}
+		return num_threads;
+	}
+
+
+	/*
+	* ids referred to by a value
+	*/
+	static void references(const Ifc_value& value, std::vector<unsigned long>& ids) {
+		if (value.kind == Ifc_value::REFERENCE) ids.push_back(value.ref);
+		for (auto const& v : value.list) references(v, ids);
+	}
+
+
+	/*
+	* parse the arguments of a record
+	*/
+	std::unique_ptr<Ifc_entity> decode(const Record& record) const {
+		std::unique_ptr<Ifc_entity> entity(new Ifc_entity());
+		entity->id = record.id;
+		entity->type.assign(file.begin() + record.type_begin, record.type_length);
+		for (auto& ch : entity->type) ch = (char)std::toupper((unsigned char)ch);
+		if (record.type_length == 0) return entity; // complex entity instance, not supported
+
+		const char* end = file.begin() + record.end;
+		const char* p = skip_space(file.begin() + record.type_begin + record.type_length, end);
+		if (p == end || *p != '(' || parse_list(p, end, entity->arguments) == nullptr) {
+			std::cout << "warning: cannot parse the arguments of #" << record.id << '\n';
+			entity->arguments.clear();
+		}
+		return entity;
+	}
+public:
+	IfcFile() :
+		index_threads(0) {}
+
+
+	/*
+	* map the file and index its records
+	* return: False - the file cannot be read or is not a step physical file
+	*/
+	bool open(const std::string& filename) {
+		close();
+		if (!file.open(filename)) return false;
+
+		const char* end = file.end();
+		const char* p = skip_space(file.begin(), end);
+		std::string_view magic("ISO-10303-21");
+		if ((std::size_t)(end - p) < magic.size() || std::string_view(p, magic.size()) != magic) return false;
+		p = statement_end(p, end);
+		if (p == nullptr) return false;
+		p = read_header(p + 1, end);
+		if (p == nullptr) return false;
+
+		index_threads = index_records(p, end);
+		index.reserve(records.size());
+		for (std::size_t i = 0; i != records.size(); ++i) {
+			index.emplace(records[i].id, i);
+		}
+		entities.resize(records.size());
+		return true;
+	}
+
+
+	void close() {
+		index_threads = 0;
+		records.clear();
+		index.clear();
+		entities.clear();
+		schema_.clear();
+		file.close();
+	}
+
+
+	const std::string& schema() const { return schema_; }
+	std::size_t size() const { return records.size(); }
+	std::size_t file_size() const { return file.size(); }
+	std::size_t num_index_threads() const { return index_threads; }
+
+
+	/*
+	* type name of an entity as written in the file, without parsing its arguments
+	*/
+	std::string_view type(unsigned long id) const {
+		auto it = index.find(id);
+		if (it == index.end()) return std::string_view();
+		const Record& record = records[it->second];
+		return std::string_view(file.begin() + record.type_begin, record.type_length);
+	}
+
+
+	/*
+	* ids of the entities of a type (upper case, ie IFCSPACE) in file order, subtypes are not included
+	*/
+	std::vector<unsigned long> ids_of_type(const std::string& type_name) const {
+		std::vector<unsigned long> ids;
+		std::uint32_t hash = type_hash(type_name.data(), type_name.size());
+		for (auto const& record : records) {
+			if (has_type(record, hash, type_name)) ids.push_back(record.id);
+		}
+		return ids;
+	}
+
+
+	/*
+	* decode the entities of the given types (upper case) and, level by level, the entities they refer to,
+	* each level in parallel; later entity() calls on these entities only read the cache
+	* return: the number of entities decoded
+	*/
+	std::size_t load(const std::vector<std::string>& types) {
+		std::vector<std::uint32_t> hashes;
+		for (auto const& type : types) hashes.push_back(type_hash(type.data(), type.size()));
+
+		std::vector<std::size_t> level;
+		std::vector<char> queued(records.size(), 0);
+		for (std::size_t i = 0; i != records.size(); ++i) {
+			for (std::size_t t = 0; t != types.size(); ++t) {
+				if (has_type(records[i], hashes[t], types[t])) {
+					level.push_back(i);
+					queued[i] = 1;
+					break;
+				}
+			}
+		}
+
+		std::size_t num_decoded = 0;
+		std::vector<unsigned long> ids;
+		while (!level.empty()) {
+			parallel_for(level.size(), [&](std::size_t k) {
+				std::size_t i = level[k];
+				if (!entities[i]) entities[i] = decode(records[i]);
+			});
+			num_decoded += level.size();
+
+			std::vector<std::size_t> next;
+			for (auto i : level) {
+				ids.clear();
+				for (auto const& argument : entities[i]->arguments) references(argument, ids);
+				for (auto id : ids) {
+					auto it = index.find(id);
+					if (it == index.end() || queued[it->second]) continue;
+					queued[it->second] = 1;
+					next.push_back(it->second);
+				}
+			}
+			level.swap(next);
+		}
+		return num_decoded;
+	}
+
+
+	/*
+	* the entity #id, parsed on first use
+	* return: nullptr if there is no such entity
+	*/
+	const Ifc_entity* entity(unsigned long id) const {
+		auto it = index.find(id);
+		if (it == index.end()) return nullptr;
+		std::unique_ptr<Ifc_entity>& entity = entities[it->second];
+		if (!entity) entity = decode(records[it->second]);
+		return entity.get();
+	}
+
+
+	/*
+	* the entity a value refers to
+	* return: nullptr if the value is not a reference or the reference is dangling
+	*/
+	const Ifc_entity* resolve(const Ifc_value& value) const {
+		return value.is_reference() ? entity(value.ref) : nullptr;
+	}
+};
+
+
+// affine transformation of ifc placements: rotation and scale in the first three columns, translation in the last one
+struct Ifc_matrix {
+	double m[3][4];
+
+	Ifc_matrix() {
+		for (int i = 0; i != 3; ++i)
+			for (int j = 0; j != 4; ++j)
+				m[i][j] = i == j ? 1.0 : 0.0;
+	}
+
+	Ifc_matrix(const Vector3d& origin, const Vector3d& x, const Vector3d& y, const Vector3d& z) {
+		const Vector3d* columns[4] = { &x, &y, &z, &origin };
+		for (int j = 0; j != 4; ++j) {
+			m[0][j] = columns[j]->x; m[1][j] = columns[j]->y; m[2][j] = columns[j]->z;
+		}
+	}
+
+	Ifc_matrix operator*(const Ifc_matrix& b) const {
+		Ifc_matrix c;
+		for (int i = 0; i != 3; ++i) {
+			for (int j = 0; j != 4; ++j) {
+				c.m[i][j] = m[i][0] * b.m[0][j] + m[i][1] * b.m[1][j] + m[i][2] * b.m[2][j] + (j == 3 ? m[i][3] : 0.0);
+			}
+		}
+		return c;
+	}
+
+	Vector3d apply(const Vector3d& p) const {
+		return Vector3d(
+			m[0][0] * p.x + m[0][1] * p.y + m[0][2] * p.z + m[0][3],
+			m[1][0] * p.x + m[1][1] * p.y + m[1][2] * p.z + m[1][3],
+			m[2][0] * p.x + m[2][1] * p.y + m[2][2] * p.z + m[2][3]);
+	}
+
+	Vector3d apply_direction(const Vector3d& d) const {
+		return Vector3d(
+			m[0][0] * d.x + m[0][1] * d.y + m[0][2] * d.z,
+			m[1][0] * d.x + m[1][1] * d.y + m[1][2] * d.z,
+			m[2][0] * d.x + m[2][1] * d.y + m[2][2] * d.z);
+	}
+};
+
+
+// decimal number as written in the file: mantissa * 10^exponent
+struct Ifc_decimal {
+	long long mantissa;
+	int exponent;
+
+	Ifc_decimal() :
+		mantissa(0), exponent(0) {}
+
+	Ifc_decimal(long long m, int e) :
+		mantissa(m), exponent(e)
+	{
+		if (mantissa == 0) exponent = 0;
+		while (mantissa != 0 && mantissa % 10 == 0) {
+			mantissa /= 10;
+			++exponent;
+		}
+	}
+
+	double value() const { return (double)mantissa * std::pow(10.0, exponent); }
+
+	Ifc_decimal operator-() const { return Ifc_decimal(-mantissa, exponent); }
+
+	Ifc_decimal half() const { return Ifc_decimal(mantissa * 5, exponent - 1); }
+
+	Ifc_decimal operator*(const Ifc_decimal& b) const {
+		const long long limit = 3037000499LL; // sqrt of the largest long long
+		if (std::llabs(mantissa) > limit || std::llabs(b.mantissa) > limit) return from_double(value() * b.value());
+		return Ifc_decimal(mantissa * b.mantissa, exponent + b.exponent);
+	}
+
+
+	/*
+	* parse a step number, ie "-0.5", "2.", "6.1230318E-17"
+	* digits beyond 17 significant digits are dropped
+	*/
+	static Ifc_decimal parse(std::string_view token) {
+		long long m = 0;
+		int e = 0;
+		bool negative = false, fraction = false;
+		std::size_t i = 0;
+		if (i < token.size() && (token[i] == '-' || token[i] == '+')) negative = token[i++] == '-';
+		for (; i < token.size(); ++i) {
+			char c = token[i];
+			if (c == '.') fraction = true;
+			else if (c >= '0' && c <= '9') {
+				if (m < 10000000000000000LL) {
+					m = m * 10 + (c - '0');
+					if (fraction) --e;
+				}
+				else if (!fraction) ++e;
+			}
+			else if (c == 'E' || c == 'e') {
+				std::size_t k = i + 1;
+				if (k < token.size() && token[k] == '+') ++k;
+				int power = 0;
+				std::from_chars(token.data() + k, token.data() + token.size(), power);
+				e += power;
+				break;
+			}
+		}
+		return Ifc_decimal(negative ? -m : m, e);
+	}
+
+
+	/*
+	* a computed number, rounded to 15 significant digits
+	*/
+	static Ifc_decimal from_double(double x) {
+		char number[32];
+		std::snprintf(number, sizeof(number), "%.15g", x);
+		return parse(number);
+	}
+};
+
+
+// solid of a body item as a csg tree, the leaves are extrusions and half spaces, see IfcGeometry::solid
+struct Ifc_solid {
+	enum Kind { EXTRUSION, HALF_SPACE, DIFFERENCE, UNION, INTERSECTION };
+
+	Kind kind;
+	Ifc_matrix position; // EXTRUSION: coordinates of the profile, HALF_SPACE: coordinates of the plane, which is z = 0
+	std::vector<std::array<Ifc_decimal, 2>> profile; // EXTRUSION: outer boundary, HALF_SPACE: polygonal boundary if any; counterclockwise
+	std::array<Ifc_decimal, 3> extrusion; // EXTRUSION: extrusion vector, direction times depth
+	bool agreement; // HALF_SPACE: the normal of the plane points away from the half space
+	Ifc_matrix boundary_position; // HALF_SPACE: coordinates of the polygonal boundary, which is extruded along z
+	std::vector<Ifc_solid> operands; // DIFFERENCE, UNION, INTERSECTION: first and second operand
+
+	Ifc_solid() :
+		kind(EXTRUSION), agreement(false) {}
+};
+
+
+// solid of a body item placed in world coordinates (model units)
+struct Ifc_placed_solid {
+	Ifc_matrix placement;
+	Ifc_solid solid;
+};
+
+
+// body geometry of one product, in world coordinates and model units
+struct Ifc_product {
+	unsigned long id;
+	std::string global_id;
+	std::string type;
+	std::vector<std::vector<Vector3d>> faces; // outer boundary of each face, faces of all representation items together
+	std::vector<Ifc_placed_solid> solids; // with the extrusion fast path, if all body items are solids (then faces is empty)
+	std::vector<Ifc_placed_solid> openings; // solids of the openings voiding the product, subtracted from solids
+};
+
+
+
+/*
+* geometry of ifc products: placements, representation items and profiles
+* faceted breps and surface models are read face by face, extrusions become prisms, mapped items are placed copies
+* boolean clipping results keep their first operand and inner face bounds are dropped, both are reported as warnings
+* openings (IfcRelVoidsElement) are only subtracted from products made of solids, see product(); the openings of
+* products read as faces are reported as warnings too
+*/
+class IfcGeometry {
+private:
+	const IfcFile& file;
+	double unit; // metres per length unit of the file
+	std::map<std::string, std::size_t> skipped; // unsupported geometry -> number of occurrences
+	std::map<unsigned long, std::vector<unsigned long>> voids; // product id -> ids of its opening elements
+
+	static double dot(const Vector3d& a, const Vector3d& b) {
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+
+	static Vector3d cross(const Vector3d& a, const Vector3d& b) {
+		return Vector3d(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+	}
+
+
+	static Vector3d normalize(const Vector3d& a, const Vector3d& fallback) {
+		double length = std::sqrt(dot(a, a));
+		if (length < Epsilon) return fallback;
+		return Vector3d(a.x / length, a.y / length, a.z / length);
+	}
+
+
+	void skip(const std::string& what) {
+		++skipped[what];
+	}
+
+
+	/*
+	* ifc local coordinate system: z from axis, x from the reference direction projected into the plane normal to z
+	*/
+	static Ifc_matrix coordinate_system(const Vector3d& origin, const Vector3d& axis, const Vector3d& reference) {
+		Vector3d z = normalize(axis, Vector3d(0, 0, 1));
+		double along = dot(reference, z);
+		Vector3d x = normalize(Vector3d(reference.x - along * z.x, reference.y - along * z.y, reference.z - along * z.z), Vector3d());
+		if (dot(x, x) == 0) {
+			// reference direction parallel to the axis: any perpendicular direction
+			x = normalize(std::abs(z.x) < 0.9 ? cross(Vector3d(0, 1, 0), z) : cross(z, Vector3d(0, 0, 1)), Vector3d(1, 0, 0));
+		}
+		return Ifc_matrix(origin, x, cross(z, x), z);
+	}
+
+
+	/*
+	* outer boundary of a face, oriented as the face
+	*/
+	void face_polygon(const Ifc_entity* face, const Ifc_matrix& m, std::vector<std::vector<Vector3d>>& faces) {
+		const Ifc_value& bounds = (*face)[0];
+		const Ifc_entity* outer = nullptr;
+		for (auto const& bound : bounds.list) {
+			const Ifc_entity* b = file.resolve(bound);
+			if (b == nullptr) continue;
+			if (b->type == "IFCFACEOUTERBOUND" || outer == nullptr) outer = b;
+		}
+		if (outer == nullptr) return;
+		if (bounds.list.size() > 1) skip("inner face bound");
+
+		const Ifc_entity* loop = file.resolve((*outer)[0]);
+		if (loop == nullptr || loop->type != "IFCPOLYLOOP") {
+			skip(loop == nullptr ? std::string("face bound") : loop->type);
+			return;
+		}
+		std::vector<Vector3d> polygon;
+		for (auto const& p : (*loop)[0].list) {
+			polygon.push_back(m.apply(point(p.ref)));
+		}
+		if (!(*outer)[1].boolean()) std::reverse(polygon.begin(), polygon.end());
+		if (polygon.size() >= 3) faces.emplace_back(std::move(polygon));
+	}
+
+
+	/*
+	* faces of a closed shell, open shell or connected face set
+	*/
+	void shell_faces(const Ifc_entity* shell, const Ifc_matrix& m, std::vector<std::vector<Vector3d>>& faces) {
+		for (auto const& f : (*shell)[0].list) {
+			const Ifc_entity* face = file.resolve(f);
+			if (face != nullptr) face_polygon(face, m, faces);
+		}
+	}
+
+
+	/*
+	* prism of an IfcExtrudedAreaSolid: bottom, top and one quad per profile edge, oriented outwards
+	*/
+	void extrusion_faces(const Ifc_entity* solid, const Ifc_matrix& m, std::vector<std::vector<Vector3d>>& faces) {
+		std::vector<Vector3d> base = profile((*solid)[0].ref);
+		if (base.size() < 3) return;
+
+		Ifc_matrix position = m * axis2_placement((*solid)[1].ref);
+		Vector3d d = direction((*solid)[2].ref);
+		double depth = (*solid)[3].real();
+		Vector3d extrusion(d.x * depth, d.y * depth, d.z * depth);
+		if (extrusion.z < 0) std::reverse(base.begin(), base.end()); // the profile is counterclockwise seen from the top face
+
+		std::vector<Vector3d> bottom, top;
+		for (auto const& p : base) {
+			bottom.push_back(position.apply(p));
+			top.push_back(position.apply(Vector3d(p.x + extrusion.x, p.y + extrusion.y, p.z + extrusion.z)));
+		}
+		for (std::size_t i = 0, n = base.size(); i != n; ++i) {
+			std::size_t j = (i + 1) % n;
+			faces.push_back({ bottom[i], bottom[j], top[j], top[i] });
+		}
+		std::reverse(bottom.begin(), bottom.end());
+		faces.emplace_back(std::move(bottom));
+		faces.emplace_back(std::move(top));
+	}
+
+
+	/*
+	* faces of a representation item placed by m
+	*/
+	void item_faces(unsigned long id, const Ifc_matrix& m, std::vector<std::vector<Vector3d>>& faces) {
+		const Ifc_entity* item = file.entity(id);
+		if (item == nullptr) return;
+		const std::string& type = item->type;
+
+		if (type == "IFCFACETEDBREP" || type == "IFCFACETEDBREPWITHVOIDS") {
+			const Ifc_entity* shell = file.resolve((*item)[0]);
+			if (shell != nullptr) shell_faces(shell, m, faces);
+			if (type == "IFCFACETEDBREPWITHVOIDS") skip("brep void");
+		}
+		else if (type == "IFCCLOSEDSHELL" || type == "IFCOPENSHELL" || type == "IFCCONNECTEDFACESET") {
+			shell_faces(item, m, faces);
+		}
+		else if (type == "IFCSHELLBASEDSURFACEMODEL" || type == "IFCFACEBASEDSURFACEMODEL") {
+			for (auto const& s : (*item)[0].list) {
+				const Ifc_entity* shell = file.resolve(s);
+				if (shell != nullptr) shell_faces(shell, m, faces);
+			}
+		}
+		else if (type == "IFCEXTRUDEDAREASOLID") {
+			extrusion_faces(item, m, faces);
+		}
+		else if (type == "IFCMAPPEDITEM") {
+			const Ifc_entity* source = file.resolve((*item)[0]); // IfcRepresentationMap
+			if (source == nullptr) return;
+			Ifc_matrix placement = m * transformation_operator((*item)[1].ref) * axis2_placement((*source)[0].ref);
+			const Ifc_entity* representation = file.resolve((*source)[1]);
+			if (representation == nullptr) return;
+			for (auto const& i : (*representation)[3].list) {
+				item_faces(i.ref, placement, faces);
+			}
+		}
+		else if (type == "IFCBOOLEANCLIPPINGRESULT" || type == "IFCBOOLEANRESULT") {
+			item_faces((*item)[1].ref, m, faces);
+			if ((*item)[0].text == "UNION") item_faces((*item)[2].ref, m, faces);
+			else skip(type + " " + (*item)[0].text);
+		}
+		else {
+			skip(type);
+		}
+	}
+
+	static Ifc_decimal decimal(const Ifc_value& value) {
+		return value.token.empty() ? Ifc_decimal::from_double(value.real()) : Ifc_decimal::parse(value.token);
+	}
+
+
+	/*
+	* drop repeated points and the closing point, orient counterclockwise
+	*/
+	static void clean_polygon(std::vector<std::array<Ifc_decimal, 2>>& polygon) {
+		auto same = [](const std::array<Ifc_decimal, 2>& a, const std::array<Ifc_decimal, 2>& b) {
+			return std::abs(a[0].value() - b[0].value()) < Epsilon && std::abs(a[1].value() - b[1].value()) < Epsilon;
+		};
+		std::vector<std::array<Ifc_decimal, 2>> cleaned;
+		for (auto const& p : polygon) {
+			if (cleaned.empty() || !same(p, cleaned.back())) cleaned.push_back(p);
+		}
+		while (cleaned.size() > 1 && same(cleaned.front(), cleaned.back())) cleaned.pop_back();
+
+		double area = 0;
+		for (std::size_t i = 0, n = cleaned.size(); i != n; ++i) {
+			const auto& a = cleaned[i];
+			const auto& b = cleaned[(i + 1) % n];
+			area += a[0].value() * b[1].value() - b[0].value() * a[1].value();
+		}
+		if (area < 0) std::reverse(cleaned.begin(), cleaned.end());
+		polygon.swap(cleaned);
+	}
+
+
+	/*
+	* points of an IfcPolyline or of an IfcCompositeCurve made of polylines, as decimals
+	* return: False - other curves
+	*/
+	bool decimal_curve(unsigned long id, std::vector<std::array<Ifc_decimal, 2>>& points) const {
+		const Ifc_entity* curve = file.entity(id);
+		if (curve == nullptr) return false;
+		if (curve->type == "IFCPOLYLINE") {
+			for (auto const& p : (*curve)[0].list) {
+				const Ifc_entity* point = file.resolve(p);
+				if (point == nullptr || (*point)[0].list.size() < 2) return false;
+				points.push_back({ decimal((*point)[0].list[0]), decimal((*point)[0].list[1]) });
+			}
+			return true;
+		}
+		if (curve->type == "IFCCOMPOSITECURVE") {
+			for (auto const& s : (*curve)[0].list) {
+				const Ifc_entity* segment = file.resolve(s);
+				std::vector<std::array<Ifc_decimal, 2>> segment_points;
+				if (segment == nullptr || !decimal_curve((*segment)[2].ref, segment_points)) return false;
+				if (!(*segment)[1].boolean()) std::reverse(segment_points.begin(), segment_points.end());
+				points.insert(points.end(), segment_points.begin(), segment_points.end());
+			}
+			return true;
+		}
+		return false;
+	}
+
+
+	/*
+	* IfcExtrudedAreaSolid of a rectangle or of a closed polyline profile without voids
+	*/
+	bool extrusion_solid(const Ifc_entity* e, Ifc_solid& s) const {
+		const Ifc_entity* def = file.resolve((*e)[0]);
+		if (def == nullptr) return false;
+		Ifc_matrix profile_position;
+		if (def->type == "IFCRECTANGLEPROFILEDEF") {
+			profile_position = axis2_placement((*def)[2].ref);
+			Ifc_decimal hx = decimal((*def)[3]).half(), hy = decimal((*def)[4]).half();
+			s.profile = { { -hx, -hy }, { hx, -hy }, { hx, hy }, { -hx, hy } };
+		}
+		else if (def->type == "IFCARBITRARYCLOSEDPROFILEDEF") {
+			if (!decimal_curve((*def)[2].ref, s.profile)) return false;
+			clean_polygon(s.profile);
+		}
+		else return false;
+		if (s.profile.size() < 3) return false;
+
+		// an axis aligned direction is exact, others are normalized
+		const Ifc_entity* d = file.resolve((*e)[2]);
+		if (d == nullptr) return false;
+		Vector3d v = direction(d->id);
+		Vector3d n = normalize(v, Vector3d());
+		double components[3] = { n.x, n.y, n.z };
+		Ifc_decimal depth = decimal((*e)[3]);
+		for (int i = 0; i != 3; ++i) {
+			double c = components[i];
+			s.extrusion[i] = std::abs(c - std::round(c)) < Ifc_Axis_Tolerance ? Ifc_decimal((long long)std::round(c), 0) * depth : Ifc_decimal::from_double(c * depth.value());
+		}
+		if (s.extrusion[2].mantissa == 0) return false; // extrusion within the profile plane
+
+		s.kind = Ifc_solid::EXTRUSION;
+		s.position = axis2_placement((*e)[1].ref) * profile_position;
+		return true;
+	}
+
+
+	/*
+	* IfcHalfSpaceSolid, IfcBoxedHalfSpace (the box only bounds its display) or IfcPolygonalBoundedHalfSpace of a plane
+	*/
+	bool half_space_solid(const Ifc_entity* e, Ifc_solid& s) const {
+		const Ifc_entity* surface = file.resolve((*e)[0]);
+		if (surface == nullptr || surface->type != "IFCPLANE") return false;
+		s.kind = Ifc_solid::HALF_SPACE;
+		s.position = axis2_placement((*surface)[0].ref);
+		s.agreement = (*e)[1].boolean();
+		if (e->type == "IFCPOLYGONALBOUNDEDHALFSPACE") {
+			s.boundary_position = axis2_placement((*e)[2].ref);
+			if (!decimal_curve((*e)[3].ref, s.profile)) return false;
+			clean_polygon(s.profile);
+			if (s.profile.size() < 3) return false;
+		}
+		return true;
+	}
+
+
+	/*
+	* csg tree of a solid item: extrusions, half spaces and boolean results of them
+	* return: False - the item contains other geometry
+	*/
+	bool solid(unsigned long id, Ifc_solid& s) const {
+		const Ifc_entity* item = file.entity(id);
+		if (item == nullptr) return false;
+		const std::string& type = item->type;
+
+		if (type == "IFCEXTRUDEDAREASOLID") return extrusion_solid(item, s);
+		if (type == "IFCHALFSPACESOLID" || type == "IFCBOXEDHALFSPACE" || type == "IFCPOLYGONALBOUNDEDHALFSPACE") {
+			return half_space_solid(item, s);
+		}
+		if (type == "IFCBOOLEANRESULT" || type == "IFCBOOLEANCLIPPINGRESULT") {
+			const std::string& op = (*item)[0].text;
+			if (op == "DIFFERENCE") s.kind = Ifc_solid::DIFFERENCE;
+			else if (op == "UNION") s.kind = Ifc_solid::UNION;
+			else if (op == "INTERSECTION") s.kind = Ifc_solid::INTERSECTION;
+			else return false;
+			s.operands.resize(2);
+			// a half space is only bounded as the second operand of a difference or an intersection
+			return solid((*item)[1].ref, s.operands[0]) && solid((*item)[2].ref, s.operands[1]) &&
+				s.operands[0].kind != Ifc_solid::HALF_SPACE &&
+				!(s.kind == Ifc_solid::UNION && s.operands[1].kind == Ifc_solid::HALF_SPACE);
+		}
+		return false;
+	}
+
+
+	/*
+	* solids of a representation item placed by m, mapped items are followed
+	* return: False - the item is not a solid of extrusions
+	*/
+	bool item_solids(unsigned long id, const Ifc_matrix& m, std::vector<Ifc_placed_solid>& solids) const {
+		const Ifc_entity* item = file.entity(id);
+		if (item == nullptr) return false;
+		if (item->type == "IFCMAPPEDITEM") {
+			const Ifc_entity* source = file.resolve((*item)[0]);
+			const Ifc_entity* representation = source == nullptr ? nullptr : file.resolve((*source)[1]);
+			if (representation == nullptr) return false;
+			Ifc_matrix placement = m * transformation_operator((*item)[1].ref) * axis2_placement((*source)[0].ref);
+			for (auto const& i : (*representation)[3].list) {
+				if (!item_solids(i.ref, placement, solids)) return false;
+			}
+			return true;
+		}
+		Ifc_placed_solid placed;
+		placed.placement = m;
+		if (!solid(id, placed.solid)) return false;
+		solids.push_back(placed);
+		return true;
+	}
+
+
+	/*
+	* object placement of a product in world coordinates, scaled to metres
+	*/
+	Ifc_matrix world_placement(const Ifc_entity* e) {
+		Ifc_matrix placement = (*e)[5].is_null() ? Ifc_matrix() : object_placement((*e)[5].ref);
+		for (int i = 0; i != 3; ++i)
+			for (int j = 0; j != 4; ++j)
+				placement.m[i][j] *= unit;
+		return placement;
+	}
+
+
+	/*
+	* solids of the openings voiding a product, in world coordinates
+	* return: False - the body of an opening is not a solid of extrusions
+	*/
+	bool opening_solids(unsigned long id, std::vector<Ifc_placed_solid>& solids) {
+		auto it = voids.find(id);
+		if (it == voids.end()) return true;
+		for (auto opening_id : it->second) {
+			const Ifc_entity* opening = file.entity(opening_id);
+			if (opening == nullptr) continue;
+			Ifc_matrix placement = world_placement(opening);
+			for (auto item : body_items(opening)) {
+				if (!item_solids(item, placement, solids)) return false;
+			}
+		}
+		return true;
+	}
+public:
+	explicit IfcGeometry(const IfcFile& f) :
+		file(f), unit(length_unit(f)) {
+		// IfcRelVoidsElement: RelatingBuildingElement, RelatedOpeningElement
+		for (auto id : f.ids_of_type("IFCRELVOIDSELEMENT")) {
+			const Ifc_entity* rel = f.entity(id);
+			if (f.resolve((*rel)[4]) == nullptr || f.resolve((*rel)[5]) == nullptr) continue;
+			voids[(*rel)[4].ref].push_back((*rel)[5].ref);
+		}
+	}
+
+
+	/*
+	* metres per length unit, from the IfcSIUnit of type LENGTHUNIT (ie 0.001 for millimetres)
+	*/
+	static double length_unit(const IfcFile& f) {
+		static const std::map<std::string, double> prefixes = {
+			{ "KILO", 1e3 }, { "HECTO", 1e2 }, { "DECA", 1e1 }, { "DECI", 1e-1 }, { "CENTI", 1e-2 }, { "MILLI", 1e-3 }, { "MICRO", 1e-6 }
+		};
+		for (auto id : f.ids_of_type("IFCSIUNIT")) {
+			const Ifc_entity* unit = f.entity(id);
+			if ((*unit)[1].text != "LENGTHUNIT") continue;
+			auto prefix = prefixes.find((*unit)[2].text);
+			return prefix == prefixes.end() ? 1.0 : prefix->second;
+		}
+		return 1.0;
+	}
+
+
+	/*
+	* IfcCartesianPoint, 2d points have z = 0
+	*/
+	Vector3d point(unsigned long id) const {
+		const Ifc_entity* p = file.entity(id);
+		if (p == nullptr) return Vector3d();
+		const std::vector<Ifc_value>& c = (*p)[0].list;
+		return Vector3d(
+			c.size() > 0 ? c[0].real() : 0.0,
+			c.size() > 1 ? c[1].real() : 0.0,
+			c.size() > 2 ? c[2].real() : 0.0);
+	}
+
+
+	/*
+	* IfcDirection, not normalized
+	*/
+	Vector3d direction(unsigned long id) const {
+		return point(id); // same layout: a list of ratios
+	}
+
+
+	/*
+	* IfcAxis2Placement3D or IfcAxis2Placement2D, an unset id gives the identity
+	*/
+	Ifc_matrix axis2_placement(unsigned long id) const {
+		const Ifc_entity* placement = file.entity(id);
+		if (placement == nullptr) return Ifc_matrix();
+		Vector3d origin = point((*placement)[0].ref);
+		if (placement->type == "IFCAXIS2PLACEMENT2D") {
+			Vector3d reference = (*placement)[1].is_null() ? Vector3d(1, 0, 0) : direction((*placement)[1].ref);
+			return coordinate_system(origin, Vector3d(0, 0, 1), reference);
+		}
+		Vector3d axis = (*placement)[1].is_null() ? Vector3d(0, 0, 1) : direction((*placement)[1].ref);
+		Vector3d reference = (*placement)[2].is_null() ? Vector3d(1, 0, 0) : direction((*placement)[2].ref);
+		return coordinate_system(origin, axis, reference);
+	}
+
+
+	/*
+	* IfcLocalPlacement relative to its parent placements, ie the object placement of a product
+	*/
+	Ifc_matrix object_placement(unsigned long id) {
+		const Ifc_entity* placement = file.entity(id);
+		if (placement == nullptr) return Ifc_matrix();
+		if (placement->type != "IFCLOCALPLACEMENT") {
+			skip(placement->type);
+			return Ifc_matrix();
+		}
+		Ifc_matrix relative = axis2_placement((*placement)[1].ref);
+		if ((*placement)[0].is_null()) return relative;
+		return object_placement((*placement)[0].ref) * relative;
+	}
+
+
+	/*
+	* IfcCartesianTransformationOperator3D (uniform or non uniform scale) of a mapped item
+	*/
+	Ifc_matrix transformation_operator(unsigned long id) const {
+		const Ifc_entity* op = file.entity(id);
+		if (op == nullptr) return Ifc_matrix();
+		Vector3d x = (*op)[0].is_null() ? Vector3d(1, 0, 0) : direction((*op)[0].ref);
+		Vector3d origin = point((*op)[2].ref);
+		Vector3d z = (*op)[4].is_null() ? Vector3d(0, 0, 1) : direction((*op)[4].ref);
+		Ifc_matrix m = coordinate_system(origin, z, x);
+
+		double scale = (*op)[3].is_null() ? 1.0 : (*op)[3].real();
+		double scales[3] = { scale, scale, scale };
+		if (op->type == "IFCCARTESIANTRANSFORMATIONOPERATOR3DNONUNIFORM") {
+			if (!(*op)[5].is_null()) scales[1] = (*op)[5].real();
+			if (!(*op)[6].is_null()) scales[2] = (*op)[6].real();
+		}
+		for (int i = 0; i != 3; ++i)
+			for (int j = 0; j != 3; ++j)
+				m.m[i][j] *= scales[j];
+		return m;
+	}
+
+
+	/*
+	* outer boundary of a profile in its own plane (z = 0), counterclockwise, without the closing point
+	* IfcRectangleProfileDef and IfcArbitraryClosedProfileDef bounded by polylines or composite curves of polylines
+	*/
+	std::vector<Vector3d> profile(unsigned long id) {
+		std::vector<Vector3d> polygon;
+		const Ifc_entity* def = file.entity(id);
+		if (def == nullptr) return polygon;
+
+		if (def->type == "IFCRECTANGLEPROFILEDEF") {
+			Ifc_matrix position = axis2_placement((*def)[2].ref);
+			double hx = (*def)[3].real() / 2, hy = (*def)[4].real() / 2;
+			polygon = {
+				position.apply(Vector3d(-hx, -hy, 0)), position.apply(Vector3d(hx, -hy, 0)),
+				position.apply(Vector3d(hx, hy, 0)), position.apply(Vector3d(-hx, hy, 0)) };
+		}
+		else if (def->type == "IFCARBITRARYCLOSEDPROFILEDEF" || def->type == "IFCARBITRARYPROFILEDEFWITHVOIDS") {
+			curve_points((*def)[2].ref, polygon);
+			if (def->type == "IFCARBITRARYPROFILEDEFWITHVOIDS") skip("profile void");
+		}
+		else {
+			skip(def->type);
+			return polygon;
+		}
+
+		// drop the closing point and repeated points, orient counterclockwise
+		std::vector<Vector3d> cleaned;
+		for (auto const& p : polygon) {
+			if (!cleaned.empty() && std::abs(p.x - cleaned.back().x) < Epsilon && std::abs(p.y - cleaned.back().y) < Epsilon) continue;
+			cleaned.push_back(p);
+		}
+		while (cleaned.size() > 1 && std::abs(cleaned.front().x - cleaned.back().x) < Epsilon && std::abs(cleaned.front().y - cleaned.back().y) < Epsilon) {
+			cleaned.pop_back();
+		}
+		double area = 0;
+		for (std::size_t i = 0, n = cleaned.size(); i != n; ++i) {
+			const Vector3d& a = cleaned[i];
+			const Vector3d& b = cleaned[(i + 1) % n];
+			area += a.x * b.y - b.x * a.y;
+		}
+		if (area < 0) std::reverse(cleaned.begin(), cleaned.end());
+		return cleaned;
+	}
+
+
+	/*
+	* points of an IfcPolyline or of an IfcCompositeCurve made of polylines
+	*/
+	void curve_points(unsigned long id, std::vector<Vector3d>& points) {
+		const Ifc_entity* curve = file.entity(id);
+		if (curve == nullptr) return;
+		if (curve->type == "IFCPOLYLINE") {
+			for (auto const& p : (*curve)[0].list) {
+				points.push_back(point(p.ref));
+			}
+		}
+		else if (curve->type == "IFCCOMPOSITECURVE") {
+			for (auto const& s : (*curve)[0].list) {
+				const Ifc_entity* segment = file.resolve(s); // IfcCompositeCurveSegment
+				if (segment == nullptr) continue;
+				std::vector<Vector3d> segment_points;
+				curve_points((*segment)[2].ref, segment_points);
+				if (!(*segment)[1].boolean()) std::reverse(segment_points.begin(), segment_points.end());
+				points.insert(points.end(), segment_points.begin(), segment_points.end());
+			}
+		}
+		else {
+			skip(curve->type);
+		}
+	}
+
+
+	/*
+	* representation items of the Body representation of a product (IfcProductDefinitionShape)
+	*/
+	std::vector<unsigned long> body_items(const Ifc_entity* product) const {
+		std::vector<unsigned long> items;
+		const Ifc_entity* shape = file.resolve((*product)[6]);
+		if (shape == nullptr) return items;
+		for (auto const& r : (*shape)[2].list) {
+			const Ifc_entity* representation = file.resolve(r);
+			if (representation == nullptr || (*representation)[1].text != "Body") continue;
+			for (auto const& item : (*representation)[3].list) {
+				items.push_back(item.ref);
+			}
+		}
+		return items;
+	}
+
+
+	/*
+	* body geometry of a product in world coordinates, scaled to metres
+	* extrusions: if all body items and all openings of the product are solids of extrusions,
+	* return them as solids and openings instead of faces
+	* the openings of a product returned as faces are not subtracted, they are reported by report()
+	*/
+	Ifc_product product(unsigned long id, bool extrusions = false) {
+		Ifc_product p;
+		p.id = id;
+		const Ifc_entity* e = file.entity(id);
+		if (e == nullptr) return p;
+		p.global_id = (*e)[0].text;
+		p.type = e->type;
+
+		Ifc_matrix placement = world_placement(e);
+
+		std::vector<unsigned long> items = body_items(e);
+		if (extrusions && !items.empty()) {
+			bool all_solids = true;
+			for (auto item : items) {
+				all_solids = all_solids && item_solids(item, placement, p.solids);
+			}
+			if (all_solids && opening_solids(id, p.openings)) return p;
+			p.solids.clear();
+			p.openings.clear();
+		}
+		for (auto item : items) {
+			item_faces(item, placement, p.faces);
+		}
+		auto it = voids.find(id);
+		if (it != voids.end() && !p.faces.empty()) {
+			skipped["IFCOPENINGELEMENT not subtracted from faces"] += it->second.size();
+		}
+		return p;
+	}
+
+
+	/*
+	* products of the given types (upper case), in file order for each type
+	*/
+	std::vector<Ifc_product> products(const std::vector<std::string>& types, bool extrusions = false) {
+		std::vector<Ifc_product> result;
+		for (auto const& type : types) {
+			for (auto id : file.ids_of_type(type)) {
+				result.emplace_back(product(id, extrusions));
+			}
+		}
+		return result;
+	}
+
+
+	/*
+	* print the geometry which was skipped or only partly converted
+	*/
+	void report() const {
+		for (auto const& s : skipped) {
+			std::cout << "warning: unsupported ifc geometry ignored: " << s.first << " (" << s.second << "x)" << '\n';
+		}
+	}
+};
+
+
+
+// load the building elements of an ifc file into the obj file structures, in place of an IfcConvert run
+class LoadIFC {
+public:
+
+	/*
+	* one object with one shell per product, as in the obj files written by IfcConvert
+	* the vertices of each face are appended to f.vertices, faces index them from 1
+	* extrusions (optional): receives the products made of extrusions instead, for Build_Nef_Extrusion
+	*/
+	static void load_ifc(std::string& fname, OBJFile& f, const std::vector<std::string>& types = Ifc_Element_Types,
+		std::vector<Ifc_product>* extrusions = nullptr) {
+		Scoped_timer timer("load_ifc");
+		std::string path = INPUT_PATH;
+		std::string filename = path + fname;
+		std::cout << "-- loading ifc file: " << filename << '\n';
+
+		IfcFile ifc;
+		if (!ifc.open(filename)) {
+			std::cerr << "file open failed! " << '\n';
+			return;
+		}
+		std::cout << "schema: " << ifc.schema() << ", entities: " << ifc.size()
+			<< " (indexed using " << ifc.num_index_threads() << " threads)" << '\n';
+		std::vector<std::string> load_types = types;
+		load_types.push_back("IFCRELVOIDSELEMENT"); // and through it the openings of the products
+		std::size_t num_decoded = ifc.load(load_types);
+		std::cout << "decoded " << num_decoded << " entities of the requested types and their references" << '\n';
+
+		IfcGeometry geometry(ifc);
+		unsigned long vertex_index = 1;
+		for (auto& product : geometry.products(types, extrusions != nullptr)) {
+			if (!product.solids.empty()) {
+				extrusions->push_back(std::move(product));
+				continue;
+			}
+			if (product.faces.empty()) continue;
+
+			Object obj;
+			obj.id = product.global_id;
+			Shell shell;
+			shell.id = "1";
+			shell.obj_id = obj.id;
+			for (auto const& polygon : product.faces) {
+				Face face;
+				for (auto const& p : polygon) {
+					f.vertices.emplace_back(Vertex(p.x, p.y, p.z, vertex_index));
+					face.v_indices.push_back(vertex_index);
+					++vertex_index;
+				}
+				f.faces.push_back(face);
+				shell.faces.push_back(face);
+			}
+			f.shells.push_back(shell);
+			obj.shells.push_back(shell);
+			f.objects.push_back(obj);
+		}
+		geometry.report();
+
+		Instrumentation::count("input.vertices", (long long)f.vertices.size());
+		Instrumentation::count("input.faces", (long long)f.faces.size());
+		Instrumentation::count("input.shells", (long long)f.shells.size());
+		Instrumentation::gauge("ifc.entities", (double)ifc.size());
+		Instrumentation::gauge("ifc.decoded_entities", (double)num_decoded);
+		std::cout << "products: " << f.objects.size() << ", faces: " << f.faces.size() << '\n';
+		if (extrusions != nullptr) std::cout << "products built from extrusions: " << extrusions->size() << '\n';
+		std::cout << "loading ifc file done " << '\n';
+	}
+};
+
+
+
+/*
+* Nef polyhedra of extruded products, built directly from their profiles instead of from triangulated faces:
+* one prism per extrusion (bottom, top and one side per profile edge), in exact coordinates from the decimals of the file
+* clipping half spaces become boxes on their side of the plane, larger than the solid they clip
+* the openings of a product are subtracted from the union of its solids
+* placements are exact where their axes are along the coordinate axes (Ifc_Axis_Tolerance),
+* their translations are rounded to the snap lattice
+*/
+template <class Policy>
+class Build_Nef_Extrusion {
+private:
+	typedef typename Policy::Kernel Kernel;
+	typedef typename Kernel::RT RT;
+	typedef typename Policy::Point Point;
+	typedef typename Policy::Polyhedron Polyhedron;
+	typedef typename Policy::Nef_polyhedron Nef_polyhedron;
+	typedef typename Kernel::Aff_transformation_3 Aff_transformation;
+
+	/*
+	* exact integer, from two parts which are exact as doubles
+	*/
+	static RT integer(long long n) {
+		const long long base = 1000000000LL;
+		return RT((double)(n / base)) * RT((double)base) + RT((double)(n % base));
+	}
+
+
+	static RT power_of_ten(int n) {
+		RT p(1);
+		for (int i = 0; i < n; ++i) p = p * RT(10);
+		return p;
+	}
+
+
+	/*
+	* exact point of three decimals, over their common power of ten
+	*/
+	static Point decimal_point(const Ifc_decimal& x, const Ifc_decimal& y, const Ifc_decimal& z) {
+		int common = std::min(0, std::min(x.exponent, std::min(y.exponent, z.exponent)));
+		return Point(
+			integer(x.mantissa) * power_of_ten(x.exponent - common),
+			integer(y.mantissa) * power_of_ten(y.exponent - common),
+			integer(z.mantissa) * power_of_ten(z.exponent - common),
+			power_of_ten(-common));
+	}
+
+
+	/*
+	* exact affine transformation of a placement, see the class comment
+	* linear entries which are not integers are kept as exact doubles, over a common power of two
+	*/
+	static Aff_transformation exact_transformation(const Ifc_matrix& m) {
+		double linear[3][3];
+		int k = 0;
+		for (int i = 0; i != 3; ++i) {
+			for (int j = 0; j != 3; ++j) {
+				double v = m.m[i][j];
+				if (std::abs(v - std::round(v)) < Ifc_Axis_Tolerance) v = std::round(v);
+				linear[i][j] = v;
+				if (v == std::round(v)) continue;
+				int e;
+				std::frexp(v, &e);
+				k = std::max(k, std::numeric_limits<double>::digits - e);
+			}
+		}
+		RT scale = Snap_Enabled ? RT(Snap_Scale) : RT(1);
+		for (int i = 0; i != 3 && !Snap_Enabled; ++i) {
+			double t = m.m[i][3];
+			if (t == 0 || t == std::round(t)) continue;
+			int e;
+			std::frexp(t, &e);
+			k = std::max(k, std::numeric_limits<double>::digits - e);
+		}
+
+		// 2^k can exceed the range of a double (tiny entries), see power_of_two and scaled_integer
+		RT denominator = power_of_two<RT>(k);
+		RT entries[3][4];
+		for (int i = 0; i != 3; ++i) {
+			for (int j = 0; j != 3; ++j) {
+				entries[i][j] = scaled_integer<RT>(linear[i][j], k) * scale;
+			}
+			entries[i][3] = Snap_Enabled ?
+				RT(std::round(m.m[i][3] * Snap_Scale)) * denominator :
+				scaled_integer<RT>(m.m[i][3], k);
+		}
+		return Aff_transformation(
+			entries[0][0], entries[0][1], entries[0][2], entries[0][3],
+			entries[1][0], entries[1][1], entries[1][2], entries[1][3],
+			entries[2][0], entries[2][1], entries[2][2], entries[2][3],
+			denominator * scale);
+	}
+
+
+	/*
+	* prism over a counterclockwise polygon in the plane z = z0, oriented outwards
+	*/
+	static Nef_polyhedron prism(const std::vector<std::array<Ifc_decimal, 2>>& profile, const Ifc_decimal& z0,
+		const std::array<Ifc_decimal, 3>& extrusion) {
+		Polyhedron_builder<typename Polyhedron::HalfedgeDS> polyhedron_builder;
+		std::size_t n = profile.size();
+		bool downwards = extrusion[2].mantissa < 0; // the profile is counterclockwise seen from the top face
+		typename Kernel::Vector_3 v = decimal_point(extrusion[0], extrusion[1], extrusion[2]) - CGAL::ORIGIN;
+		for (std::size_t i = 0; i != n; ++i) {
+			const std::array<Ifc_decimal, 2>& p = profile[downwards ? n - 1 - i : i];
+			polyhedron_builder.vertices.push_back(decimal_point(p[0], p[1], z0));
+		}
+		for (std::size_t i = 0; i != n; ++i) {
+			polyhedron_builder.vertices.push_back(polyhedron_builder.vertices[i] + v);
+		}
+
+		std::vector<unsigned long> bottom, top;
+		for (std::size_t i = 0; i != n; ++i) {
+			unsigned long a = (unsigned long)i, b = (unsigned long)((i + 1) % n);
+			polyhedron_builder.faces.push_back({ a, b, b + (unsigned long)n, a + (unsigned long)n });
+			bottom.push_back((unsigned long)(n - 1 - i));
+			top.push_back((unsigned long)(n + i));
+		}
+		polyhedron_builder.faces.push_back(bottom);
+		polyhedron_builder.faces.push_back(top);
+
+		Polyhedron polyhedron;
+		polyhedron.delegate(polyhedron_builder);
+		if (polyhedron.is_closed()) {
+			Nef_polyhedron nef_poly(polyhedron);
+			return nef_poly;
+		}
+		std::cout << "warning: please check the profile of an extrusion, its prism is not closed" << '\n';
+		Nef_polyhedron N0(Nef_polyhedron::EMPTY);
+		return N0;
+	}
+
+
+	/*
+	* largest absolute coordinate of the extrusions of a solid, in its own coordinates
+	*/
+	static double extent(const Ifc_solid& s) {
+		double size = 0;
+		if (s.kind == Ifc_solid::EXTRUSION) {
+			for (auto const& p : s.profile) {
+				for (int top = 0; top != 2; ++top) {
+					Vector3d q = s.position.apply(Vector3d(
+						p[0].value() + top * s.extrusion[0].value(),
+						p[1].value() + top * s.extrusion[1].value(),
+						top * s.extrusion[2].value()));
+					size = std::max(size, std::max(std::abs(q.x), std::max(std::abs(q.y), std::abs(q.z))));
+				}
+			}
+		}
+		for (auto const& operand : s.operands) size = std::max(size, extent(operand));
+		return size;
+	}
+
+
+	/*
+	* Nef polyhedron of a csg tree in the coordinates of its item
+	* size: extent of the whole tree, the boxes of the half spaces are larger
+	*/
+	static Nef_polyhedron solid(const Ifc_solid& s, double size) {
+		switch (s.kind) {
+		case Ifc_solid::EXTRUSION: {
+			Nef_polyhedron nef_poly = prism(s.profile, Ifc_decimal(), s.extrusion);
+			nef_poly.transform(exact_transformation(s.position));
+			return nef_poly;
+		}
+		case Ifc_solid::HALF_SPACE: {
+			double origin = 0;
+			for (int i = 0; i != 3; ++i) {
+				origin = std::max(origin, std::max(std::abs(s.position.m[i][3]), std::abs(s.boundary_position.m[i][3])));
+			}
+			Ifc_decimal l((long long)std::ceil(2 * (size + origin) + 1), 0);
+			std::vector<std::array<Ifc_decimal, 2>> square = { { -l, -l }, { l, -l }, { l, l }, { -l, l } };
+
+			// below the plane if its normal points away from the half space, above it otherwise
+			Nef_polyhedron nef_poly = prism(square, s.agreement ? -l : Ifc_decimal(), { Ifc_decimal(), Ifc_decimal(), l });
+			nef_poly.transform(exact_transformation(s.position));
+			if (!s.profile.empty()) {
+				Ifc_decimal two_l(l.mantissa * 2, l.exponent);
+				Nef_polyhedron boundary = prism(s.profile, -l, { Ifc_decimal(), Ifc_decimal(), two_l });
+				boundary.transform(exact_transformation(s.boundary_position));
+				nef_poly = nef_poly * boundary;
+			}
+			return nef_poly;
+		}
+		case Ifc_solid::DIFFERENCE:
+			return solid(s.operands[0], size) - solid(s.operands[1], size);
+		case Ifc_solid::UNION:
+			return solid(s.operands[0], size) + solid(s.operands[1], size);
+		default:
+			return solid(s.operands[0], size) * solid(s.operands[1], size);
+		}
+	}
+public:
+
+	/*
+	* Nef polyhedron of placed solids in world coordinates, their union
+	*/
+	static Nef_polyhedron build(const std::vector<Ifc_placed_solid>& solids) {
+		Nef_polyhedron result(Nef_polyhedron::EMPTY);
+		for (auto const& placed : solids) {
+			Nef_polyhedron nef_poly = solid(placed.solid, extent(placed.solid));
+			nef_poly.transform(exact_transformation(placed.placement));
+			result += nef_poly;
+		}
+		return result;
+	}
+
+
+	/*
+	* Nef polyhedron of a product in world coordinates, the union of its solids minus its openings
+	*/
+	static Nef_polyhedron build(const Ifc_product& product) {
+		Nef_polyhedron result = build(product.solids);
+		if (!product.openings.empty()) result -= build(product.openings);
+		return result;
+	}
+
+
+	/*
+	* build the Nef polyhedra of the extruded products in parallel and add them to the nef list
+	*/
+	static void build_nef_polyhedra(Nef<Policy>& nef, const std::vector<Ifc_product>& products) {
+		Scoped_timer timer("build_nef_extrusions");
+		std::vector<Nef_polyhedron> results(products.size());
+		std::size_t num_threads = parallel_for(products.size(), [&](std::size_t i) {
+			results[i] = build(products[i]);
+		});
+
+		std::size_t num_facets = 0;
+		for (std::size_t i = 0; i != results.size(); ++i) {
+			if (results[i].is_empty()) {
+				std::cout << "warning: the extrusions of " << products[i].global_id << " give an empty Nef polyhedron" << '\n';
+				continue;
+			}
+			num_facets += results[i].number_of_facets();
+			Instrumentation::count("nef.extrusion_vertices", (long long)results[i].number_of_vertices());
+			nef.nef_polyhedron_list.push_back(results[i]);
+		}
+		Instrumentation::gauge("nef.extrusion_facets", (double)num_facets);
+		std::cout << "build " << products.size() << " Nef polyhedra from extrusions (" << num_facets << " facets)"
+			<< " using " << num_threads << " threads" << '\n';
+	}
+};
+
+
+// explicit instantiations for every kernel policy, see src/Kernels.cpp
+#define BIMCONVERT_IFC_INSTANTIATIONS(PREFIX, P) \
+	PREFIX template class Build_Nef_Extrusion<P>;
+
+BIMCONVERT_IFC_INSTANTIATIONS(extern, Epeck_policy)
+BIMCONVERT_IFC_INSTANTIATIONS(extern, Cartesian_rational_policy)
+BIMCONVERT_IFC_INSTANTIATIONS(extern, Homogeneous_integer_policy)
@@ -0,0 +1,199 @@
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <fstream>
+#include <iostream>
+
+#include "json.hpp"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// instrumentation of the pipeline stages, written as mybuilding.report.json next to the city json file
+const bool Instrumentation_Enabled = true;
+
+
+
+/*
+* process wide record of the run: the time spent in each stage, counters, gauges and labels
+* all methods are thread safe, the report is a json object with sorted keys:
+* {"counters": {...}, "gauges": {...}, "labels": {...}, "peak_rss_bytes": n, "stages": {"name": {"calls": n, "seconds": s}}}
+*/
+class Instrumentation {
+private:
+	struct Stage {
+		double seconds;
+		std::size_t calls;
+	};
+
+	struct State {
+		std::mutex mutex;
+		std::map<std::string, Stage> stages;
+		std::map<std::string, long long> counters;
+		std::map<std::string, double> gauges;
+		std::map<std::string, std::string> labels;
+	};
+
+	static State& state() {
+		static State s;
+		return s;
+	}
+public:
+
+	/*
+	* add the duration of one call of a stage, see Scoped_timer
+	*/
+	static void add_time(const std::string& stage, double seconds) {
+		if (!Instrumentation_Enabled) return;
+		State& s = state();
+		std::lock_guard<std::mutex> lock(s.mutex);
+		Stage& entry = s.stages.emplace(stage, Stage{ 0.0, 0 }).first->second;
+		entry.seconds += seconds;
+		++entry.calls;
+	}
+
+
+	/*
+	* add to a counter, ie the number of faces read
+	*/
+	static void count(const std::string& name, long long n = 1) {
+		if (!Instrumentation_Enabled) return;
+		State& s = state();
+		std::lock_guard<std::mutex> lock(s.mutex);
+		s.counters[name] += n;
+	}
+
+
+	/*
+	* set a gauge to its latest value, ie the number of vertices of the big Nef polyhedron
+	*/
+	static void gauge(const std::string& name, double value) {
+		if (!Instrumentation_Enabled) return;
+		State& s = state();
+		std::lock_guard<std::mutex> lock(s.mutex);
+		s.gauges[name] = value;
+	}
+
+
+	/*
+	* describe the run, ie the kernel
+	*/
+	static void label(const std::string& name, const std::string& value) {
+		if (!Instrumentation_Enabled) return;
+		State& s = state();
+		std::lock_guard<std::mutex> lock(s.mutex);
+		s.labels[name] = value;
+	}
+
+
+	/*
+	* total time of a stage so far, 0 if it did not run
+	*/
+	static double stage_seconds(const std::string& stage) {
+		State& s = state();
+		std::lock_guard<std::mutex> lock(s.mutex);
+		auto it = s.stages.find(stage);
+		return it == s.stages.end() ? 0.0 : it->second.seconds;
+	}
+
+
+	/*
+	* forget everything recorded, ie between benchmark runs
+	*/
+	static void reset() {
+		State& s = state();
+		std::lock_guard<std::mutex> lock(s.mutex);
+		s.stages.clear();
+		s.counters.clear();
+		s.gauges.clear();
+		s.labels.clear();
+	}
+
+
+	/*
+	* peak resident set size of the process in bytes, 0 if unknown
+	*/
+	static std::size_t peak_rss() {
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters;
+		if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return (std::size_t)counters.PeakWorkingSetSize;
+		return 0;
+#else
+		struct rusage usage;
+		if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+		return (std::size_t)usage.ru_maxrss; // bytes
+#else
+		return (std::size_t)usage.ru_maxrss * 1024; // kilobytes
+#endif
+#endif
+	}
+
+
+	static nlohmann::json report() {
+		nlohmann::json j;
+		State& s = state();
+		std::lock_guard<std::mutex> lock(s.mutex);
+		j["stages"] = nlohmann::json::object();
+		for (auto const& stage : s.stages) {
+			j["stages"][stage.first] = { { "seconds", stage.second.seconds }, { "calls", stage.second.calls } };
+		}
+		j["counters"] = s.counters;
+		j["gauges"] = s.gauges;
+		j["labels"] = s.labels;
+		j["peak_rss_bytes"] = peak_rss();
+		return j;
+	}
+
+
+	/*
+	* write the report to OUTPUT_PATH + fname
+	* return: False - the file can not be written
+	*/
+	static bool write_report(const std::string& fname) {
+		if (!Instrumentation_Enabled) return false;
+		std::string filename = OUTPUT_PATH + fname;
+		std::ofstream out(filename);
+		if (!out.is_open()) {
+			std::cout << "warning: can not open " << filename << '\n';
+			return false;
+		}
+		out << report().dump(2) << '\n';
+		return out.good();
+	}
+};
+
+
+// time of a scope, added to a stage of the report when the scope is left
+class Scoped_timer {
+private:
+	std::string stage;
+	std::chrono::steady_clock::time_point start;
+public:
+	explicit Scoped_timer(const std::string& stage_) :
+		stage(stage_), start(std::chrono::steady_clock::now()) {}
+
+	Scoped_timer(const Scoped_timer&) = delete;
+	Scoped_timer& operator=(const Scoped_timer&) = delete;
+
+	~Scoped_timer() {
+		Instrumentation::add_time(stage, elapsed());
+	}
+
+	double elapsed() const {
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+};
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <charconv>
+#include <cmath>
+
+#include "json.hpp"
+
+
+
+/*
+* streaming json writer, the document is written as it is produced without building a json tree
+* the text is collected in a buffer which is written to the file each time it is full
+*
+* the output matches nlohmann::json::dump(indent) byte for byte, provided the caller emits the keys
+* of each object in sorted order (nlohmann stores objects in a std::map):
+* indent < 0 - compact, indent >= 0 - one value per line, indented by indent spaces per level
+* doubles are written with the same shortest round trip conversion as nlohmann (nlohmann::detail::to_chars)
+*
+* without a file name the text stays in memory (str()), to serialize a part of a document on its own;
+* depth is then the nesting level the part will have in the document, and raw() splices it in
+*/
+class JsonStream {
+private:
+	struct Level {
+		bool is_object;
+		bool empty;
+	};
+
+	std::ofstream out_stream;
+	bool to_file; // False - the text stays in buffer
+	std::string buffer;
+	std::size_t buffer_size;
+	int indent;
+	std::size_t base_depth; // nesting level of the first value
+	std::vector<Level> levels; // open objects and arrays
+	bool after_key; // a key was written, its value follows directly
+
+
+	void write(const char* s, std::size_t n) {
+		buffer.append(s, n);
+		if (to_file && buffer.size() >= buffer_size) flush();
+	}
+
+
+	void write(const std::string& s) {
+		write(s.data(), s.size());
+	}
+
+
+	void write(char c) {
+		buffer.push_back(c);
+		if (to_file && buffer.size() >= buffer_size) flush();
+	}
+
+
+	void new_line(std::size_t depth) {
+		if (indent < 0) return;
+		write('\n');
+		buffer.append((base_depth + depth) * (std::size_t)indent, ' ');
+	}
+
+
+	/*
+	* separator and indentation before a value or a key
+	*/
+	void before_value() {
+		if (after_key) {
+			after_key = false;
+			return;
+		}
+		if (levels.empty()) return;
+		if (!levels.back().empty) write(',');
+		levels.back().empty = false;
+		new_line(levels.size());
+	}
+
+
+	void begin(bool is_object) {
+		before_value();
+		write(is_object ? '{' : '[');
+		levels.push_back({ is_object, true });
+	}
+
+
+	void end() {
+		bool empty = levels.back().empty;
+		bool is_object = levels.back().is_object;
+		levels.pop_back();
+		if (!empty) new_line(levels.size());
+		write(is_object ? '}' : ']');
+	}
+
+
+	/*
+	* escape a string as nlohmann does with ensure_ascii = false
+	*/
+	void write_escaped(const std::string& s) {
+		write('"');
+		for (unsigned char c : s) {
+			switch (c) {
+			case '"': write("\\\"", 2); break;
+			case '\\': write("\\\\", 2); break;
+			case '\b': write("\\b", 2); break;
+			case '\f': write("\\f", 2); break;
+			case '\n': write("\\n", 2); break;
+			case '\r': write("\\r", 2); break;
+			case '\t': write("\\t", 2); break;
+			default:
+				if (c <= 0x1F) {
+					static const char* hex = "0123456789abcdef";
+					char u[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF] };
+					write(u, 6);
+				}
+				else write((char)c);
+			}
+		}
+		write('"');
+	}
+public:
+	/*
+	* open the file for writing, check good() before use
+	*/
+	JsonStream(const std::string& fname, int indent_ = -1, std::size_t buffer_size_ = 1 << 20) :
+		out_stream(fname, std::ios::binary), to_file(true), buffer_size(buffer_size_), indent(indent_), base_depth(0), after_key(false)
+	{
+		buffer.reserve(buffer_size + 256);
+	}
+
+	/*
+	* in memory, for one value nested depth levels deep in the document
+	*/
+	JsonStream(int indent_, std::size_t depth) :
+		to_file(false), buffer_size(0), indent(indent_), base_depth(depth), after_key(false)
+	{}
+
+	~JsonStream() {
+		flush();
+	}
+
+	bool good() const { return !to_file || out_stream.good(); }
+
+	const std::string& str() const { return buffer; }
+
+
+	/*
+	* write the buffered text to the file
+	*/
+	void flush() {
+		if (!to_file || buffer.empty()) return;
+		out_stream.write(buffer.data(), (std::streamsize)buffer.size());
+		buffer.clear();
+	}
+
+
+	void begin_object() { begin(true); }
+	void end_object() { end(); }
+	void begin_array() { begin(false); }
+	void end_array() { end(); }
+
+
+	void key(const std::string& k) {
+		before_value();
+		write_escaped(k);
+		if (indent < 0) write(':');
+		else write(": ", 2);
+		after_key = true;
+	}
+
+
+	void value(const std::string& s) {
+		before_value();
+		write_escaped(s);
+	}
+
+
+	void value(const char* s) {
+		value(std::string(s));
+	}
+
+
+	void value(double d) {
+		before_value();
+		if (!std::isfinite(d)) {
+			write("null", 4);
+			return;
+		}
+		char number[64];
+		char* end = nlohmann::detail::to_chars(number, number + sizeof(number), d);
+		write(number, (std::size_t)(end - number));
+	}
+
+
+	void value(long long i) {
+		before_value();
+		char number[32];
+		char* end = std::to_chars(number, number + sizeof(number), i).ptr;
+		write(number, (std::size_t)(end - number));
+	}
+
+
+	void value(unsigned long long i) {
+		before_value();
+		char number[32];
+		char* end = std::to_chars(number, number + sizeof(number), i).ptr;
+		write(number, (std::size_t)(end - number));
+	}
+
+
+	void value(int i) { value((long long)i); }
+	void value(long i) { value((long long)i); }
+	void value(unsigned long i) { value((unsigned long long)i); }
+
+
+	void null() {
+		before_value();
+		write("null", 4);
+	}
+
+
+	/*
+	* a value serialized by an in memory JsonStream with the same indent, at the depth of this value
+	*/
+	void raw(const std::string& text) {
+		before_value();
+		write(text);
+	}
+};
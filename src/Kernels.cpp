@@ -0,0 +1,13 @@
+#include "Polyhedra.hpp"
+#include "IfcReader.hpp"
+
+
+// explicit instantiations of the pipeline for every kernel policy
+// the kernels can be benchmarked against each other from one build
+BIMCONVERT_KERNEL_INSTANTIATIONS(, Epeck_policy)
+BIMCONVERT_KERNEL_INSTANTIATIONS(, Cartesian_rational_policy)
+BIMCONVERT_KERNEL_INSTANTIATIONS(, Homogeneous_integer_policy)
+
+BIMCONVERT_IFC_INSTANTIATIONS(, Epeck_policy)
+BIMCONVERT_IFC_INSTANTIATIONS(, Cartesian_rational_policy)
+BIMCONVERT_IFC_INSTANTIATIONS(, Homogeneous_integer_policy)
@@ -6,9 +6,33 @@
 #include <string>
 #include <sstream>
 #include <map>
+#include <cmath>
+#include <iomanip>
+#include <algorithm>
+#include <unordered_map>
+#include <cstdlib>
+
+#include "Instrumentation.hpp"
 
 const double Epsilon = 1e-8;
 
+// snap rounding -- round the welded vertices to a fixed lattice before exact construction
+// the lattice step is 10^(-Snap_Decimals) model units, ie 4 -> 0.1 mm for a model in metres
+// off by default: the output then keeps the input coordinates, see data/outputData/mybuilding.city.json
+const bool Snap_Enabled = false;
+const int Snap_Decimals = 4;
+const double Snap_Scale = std::pow(10.0, Snap_Decimals); // lattice cells per model unit
+
+// geometry templates -- shells equal up to a translation and a multiple of 90 degrees around z share one template
+// Templates_Enabled: build the Nef polyhedron of each template once and place copies of it
+// only with Snap_Enabled: the placement is then a lattice vector and the copies are exact; without snap rounding
+// the placement comes from the input doubles and would move the copies off their shells, so every shell is built
+// Templates_Emit: write the repeated shells as BuildingInstallation objects with GeometryInstance geometry instead,
+// they are left out of the union so their geometry is written once
+const bool Templates_Enabled = false;
+const bool Templates_Emit = false;
+const double Template_Tolerance = Snap_Enabled ? 1.0 / Snap_Scale : Epsilon; // grid of the canonical coordinates
+
 // 3d vector
 struct Vector3d {
 	double x, y, z;
@@ -187,6 +211,7 @@ public:
     * coordinates of vertices may REPEATE in vertices vector
 	*/
 	static void load_obj(std::string& fname, OBJFile& f) {
+		Scoped_timer timer("load_obj");
 		std::string path = INPUT_PATH;
 		std::string filename = path + fname;
 		std::cout << "-- loading obj file: " << filename << '\n';
@@ -362,6 +387,9 @@ public:
 			if (oindex + 1 == f.objects.size() && sindex >= f.shells.size())break;
 		}
 
+		Instrumentation::count("input.vertices", (long long)f.vertices.size());
+		Instrumentation::count("input.faces", (long long)f.faces.size());
+		Instrumentation::count("input.shells", (long long)f.shells.size());
 		std::cout << "loading obj file done " << '\n';
 		
 	}
@@ -373,6 +401,7 @@ public:
 	* ie v1 and v2 are repeated -- store v1, v2 in a map v1 : v2
 	*/
 	static void repeated_vertices_info(std::string& fname, OBJFile& f) {
+		Scoped_timer timer("repeated_vertices_info");
 		
 		std::cout << "-- repeated vertcies check: " << '\n';
 		std::cout<< "Epsilon threshold: " << Epsilon << '\n';
@@ -438,6 +467,7 @@ public:
 	* repeated faces -- faces containing repeated vertices
 	*/
 	static void repeated_faces_info(std::string& fname, OBJFile& f) {
+		Scoped_timer timer("repeated_faces_info");
 		std::cout << "-- faces repeated check: " << '\n';
 		
 		// process faces containing repeated vertices -- add indices to face.v_new and set the face.contain_repeated_flag
@@ -511,6 +541,7 @@ public:
 	* result: f.new_vertices -- containing unique vertices
 	*/
 	static void process_repeated_vertices(std::string& fname, OBJFile& f) {
+		Scoped_timer timer("process_repeated_vertices");
 		std::cout << "-- process repeated vertices: " << '\n';
 		
 		// vertex vid(1-based) - corresponding index(0-based) in f.vertices = 1
@@ -560,6 +591,7 @@ public:
 		myfile.close();
 
 		std::cout << "new vertices stored in: " << filename << '\n';
+		Instrumentation::gauge("weld.vertices", (double)f.new_vertices.size());
 
 		// -- re-check --------------------------------------------------------------
 		unsigned long count = 0;
@@ -585,6 +617,7 @@ public:
 	* process faces containing repeated vertices
 	*/
 	static void process_repeated_faces(std::string& fname, OBJFile& f) {
+		Scoped_timer timer("process_repeated_faces");
 		std::cout << "-- process faces containing repeated vertices: " << '\n';
 
 		// access faces from the objects, thus the whole structure can be modified -- not directly use f.faces
@@ -672,6 +705,327 @@ public:
 
 };
 
+// snap the welded vertices to a fixed lattice and repair the faces that degenerate by snapping
+// the shells then carry small, exactly representable coordinates into the polyhedron builder
+class SnapRounding {
+private:
+	// integer coordinates of a vertex on the lattice
+	struct LatticePoint {
+		long long x, y, z;
+
+		bool operator<(const LatticePoint& other) const {
+			if (x != other.x) return x < other.x;
+			if (y != other.y) return y < other.y;
+			return z < other.z;
+		}
+
+		bool operator==(const LatticePoint& other) const {
+			return x == other.x && y == other.y && z == other.z;
+		}
+	};
+
+
+	static LatticePoint lattice_point(const Vertex& v) {
+		return LatticePoint{
+			std::llround(v.x * Snap_Scale),
+			std::llround(v.y * Snap_Scale),
+			std::llround(v.z * Snap_Scale) };
+	}
+
+
+	/*
+	* check if all vertices of a face lie on one line -- the face has no area after snapping
+	* exact, since the lattice coordinates are integers
+	*/
+	static bool collinear_face(std::vector<LatticePoint>& points) {
+		const LatticePoint& p0 = points[0];
+		const LatticePoint& p1 = points[1]; // differs from p0, consecutive duplicates are removed
+		long long ux = p1.x - p0.x, uy = p1.y - p0.y, uz = p1.z - p0.z;
+
+		for (std::size_t i = 2; i != points.size(); ++i) {
+			long long wx = points[i].x - p0.x, wy = points[i].y - p0.y, wz = points[i].z - p0.z;
+			if (uy * wz - uz * wy != 0 ||
+				uz * wx - ux * wz != 0 ||
+				ux * wy - uy * wx != 0) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+
+	/*
+	* check if all vertices of a (not collinear) face lie on one plane after snapping
+	* exact while the face spans less than Snap_Exact_Span lattice cells, a larger face is reported as not planar
+	* (the 64-bit products would overflow) and is triangulated, which keeps it valid either way
+	*/
+	static bool planar_face(std::vector<LatticePoint>& points) {
+		const long long Snap_Exact_Span = 1LL << 20;
+		const LatticePoint& p0 = points[0];
+		for (auto const& p : points) {
+			if (std::llabs(p.x - p0.x) >= Snap_Exact_Span ||
+				std::llabs(p.y - p0.y) >= Snap_Exact_Span ||
+				std::llabs(p.z - p0.z) >= Snap_Exact_Span) {
+				return false;
+			}
+		}
+		if (points.size() == 3) return true;
+
+		// normal from the first corner which is not on the line p0 p1
+		long long ux = points[1].x - p0.x, uy = points[1].y - p0.y, uz = points[1].z - p0.z;
+		long long nx = 0, ny = 0, nz = 0;
+		for (std::size_t i = 2; i != points.size() && nx == 0 && ny == 0 && nz == 0; ++i) {
+			long long wx = points[i].x - p0.x, wy = points[i].y - p0.y, wz = points[i].z - p0.z;
+			nx = uy * wz - uz * wy;
+			ny = uz * wx - ux * wz;
+			nz = ux * wy - uy * wx;
+		}
+
+		for (auto const& p : points) {
+			if (nx * (p.x - p0.x) + ny * (p.y - p0.y) + nz * (p.z - p0.z) != 0) return false;
+		}
+		return true;
+	}
+
+
+	/*
+	* split a ring which passes through the same vertex twice (two of its vertices were snapped together)
+	* into simple rings, each loop between the two visits becomes a ring of its own
+	*/
+	static std::vector<std::vector<unsigned long>> split_ring(const std::vector<unsigned long>& indices) {
+		std::vector<std::vector<unsigned long>> rings;
+		std::vector<unsigned long> ring;
+		for (auto id : indices) {
+			auto it = std::find(ring.begin(), ring.end(), id);
+			if (it != ring.end()) {
+				rings.emplace_back(it, ring.end());
+				ring.erase(it + 1, ring.end());
+			}
+			else {
+				ring.emplace_back(id);
+			}
+		}
+		rings.emplace_back(ring);
+		return rings;
+	}
+
+
+	/*
+	* triangulate a ring by ear clipping in the coordinate plane the ring is least tilted to
+	* the triangles keep the orientation of the ring
+	*/
+	static std::vector<std::vector<unsigned long>> triangulate(const std::vector<unsigned long>& ring, std::vector<LatticePoint>& points) {
+		// Newell normal, only to choose the projection
+		double nx = 0, ny = 0, nz = 0;
+		for (std::size_t i = 0; i != points.size(); ++i) {
+			const LatticePoint& a = points[i];
+			const LatticePoint& b = points[(i + 1) % points.size()];
+			nx += (double)(a.y - b.y) * (double)(a.z + b.z);
+			ny += (double)(a.z - b.z) * (double)(a.x + b.x);
+			nz += (double)(a.x - b.x) * (double)(a.y + b.y);
+		}
+		int axis = std::abs(nx) > std::abs(ny) ? (std::abs(nx) > std::abs(nz) ? 0 : 2) : (std::abs(ny) > std::abs(nz) ? 1 : 2);
+		double projected_normal = axis == 0 ? nx : (axis == 1 ? ny : nz);
+		auto u = [axis](const LatticePoint& p) { return axis == 0 ? p.y : (axis == 1 ? p.z : p.x); };
+		auto v = [axis](const LatticePoint& p) { return axis == 0 ? p.z : (axis == 1 ? p.x : p.y); };
+
+		// twice the signed area of the projected triangle a b c, oriented like the ring when positive
+		auto turn = [&](const LatticePoint& a, const LatticePoint& b, const LatticePoint& c) {
+			long long cross = (u(b) - u(a)) * (v(c) - v(a)) - (v(b) - v(a)) * (u(c) - u(a));
+			return projected_normal < 0 ? -cross : cross;
+		};
+
+		std::vector<std::vector<unsigned long>> triangles;
+		std::vector<std::size_t> left; // corners not clipped yet
+		for (std::size_t i = 0; i != ring.size(); ++i) left.emplace_back(i);
+
+		while (left.size() > 3) {
+			bool clipped = false;
+			for (std::size_t k = 0; k != left.size() && !clipped; ++k) {
+				std::size_t ia = left[(k + left.size() - 1) % left.size()], ib = left[k], ic = left[(k + 1) % left.size()];
+				const LatticePoint& a = points[ia];
+				const LatticePoint& b = points[ib];
+				const LatticePoint& c = points[ic];
+				if (turn(a, b, c) <= 0) continue; // reflex or flat corner
+
+				bool empty = true; // no other corner inside or on the ear
+				for (auto j : left) {
+					if (j == ia || j == ib || j == ic) continue;
+					if (turn(a, b, points[j]) >= 0 && turn(b, c, points[j]) >= 0 && turn(c, a, points[j]) >= 0) {
+						empty = false;
+						break;
+					}
+				}
+				if (!empty) continue;
+
+				triangles.push_back({ ring[ia], ring[ib], ring[ic] });
+				left.erase(left.begin() + k);
+				clipped = true;
+			}
+			if (!clipped) break; // no ear in a degenerated projection, fan the rest
+		}
+		for (std::size_t k = 1; k + 1 < left.size(); ++k) {
+			triangles.push_back({ ring[left[0]], ring[left[k]], ring[left[k + 1]] });
+		}
+		return triangles;
+	}
+
+
+	/*
+	* insert the vertices of the removed faces into the edges they now lie on
+	* a face which became a line A C B is removed, its neighbours had the edges A C and C B on one side
+	* and A B on the other one: inserting C into A B keeps the shell closed
+	*/
+	static std::size_t insert_on_edges(std::vector<Face>& faces, const std::vector<unsigned long>& loose, std::vector<LatticePoint>& lattice_points) {
+		std::size_t inserted = 0;
+		for (auto& face : faces) {
+			std::vector<unsigned long> indices;
+			for (std::size_t i = 0; i != face.v_new_indices.size(); ++i) {
+				unsigned long ia = face.v_new_indices[i];
+				unsigned long ib = face.v_new_indices[(i + 1) % face.v_new_indices.size()];
+				const LatticePoint& a = lattice_points[ia];
+				const LatticePoint& b = lattice_points[ib];
+				long long ux = b.x - a.x, uy = b.y - a.y, uz = b.z - a.z;
+				long long length = ux * ux + uy * uy + uz * uz;
+
+				std::vector<std::pair<long long, unsigned long>> on_edge; // position along the edge, vertex
+				for (auto id : loose) {
+					const LatticePoint& w = lattice_points[id];
+					long long wx = w.x - a.x, wy = w.y - a.y, wz = w.z - a.z;
+					if (uy * wz - uz * wy != 0 || uz * wx - ux * wz != 0 || ux * wy - uy * wx != 0) continue;
+					long long position = ux * wx + uy * wy + uz * wz;
+					if (position > 0 && position < length) on_edge.emplace_back(position, id);
+				}
+				std::sort(on_edge.begin(), on_edge.end());
+
+				indices.emplace_back(ia);
+				for (auto const& w : on_edge) {
+					if (indices.back() != w.second) indices.emplace_back(w.second);
+				}
+			}
+			inserted += indices.size() - face.v_new_indices.size();
+			face.v_new_indices = indices;
+		}
+		return inserted;
+	}
+public:
+
+	/*
+	* snap f.new_vertices to the lattice and repair the faces in f.objects, so that each shell stays closed
+	* - vertices falling on the same lattice point are merged -- the first one is kept
+	* - a face loses consecutive repeated indices, and is split where it passes through a vertex twice
+	* - a face with less than 3 vertices, or with all its vertices collinear, is removed: its vertices
+	*   are inserted into the edges of the other faces of the shell they now lie on
+	* - a face which is no longer planar is triangulated
+	* the shells touched by a repair are listed by number, as in output_each_shell
+	* should be called after process_repeated_faces, face.v_new_indices are 1-based newid
+	*/
+	static void snap_vertices(OBJFile& f) {
+		Scoped_timer timer("snap_vertices");
+		std::cout << "-- snap rounding: " << '\n';
+		std::cout << "lattice step: " << 1.0 / Snap_Scale << '\n';
+
+		// step 1: snap each vertex and find the first vertex on each lattice point
+		std::map<LatticePoint, unsigned long> lattice_dict; // lattice point -> newid
+		std::vector<unsigned long> merged_id(f.new_vertices.size() + 1, 0); // newid -> newid after merging
+		std::vector<LatticePoint> lattice_points(f.new_vertices.size() + 1);
+		unsigned long merged_count = 0;
+
+		for (auto& v : f.new_vertices) {
+			LatticePoint lp = lattice_point(v);
+			v.x = (double)lp.x / Snap_Scale;
+			v.y = (double)lp.y / Snap_Scale;
+			v.z = (double)lp.z / Snap_Scale;
+
+			auto it = lattice_dict.find(lp);
+			if (it == lattice_dict.end()) {
+				lattice_dict[lp] = v.newid;
+				merged_id[v.newid] = v.newid;
+			}
+			else {
+				merged_id[v.newid] = it->second;
+				++merged_count;
+			}
+			lattice_points[v.newid] = lp;
+		}
+
+		// step 2: re-index and repair the faces, shell by shell
+		unsigned long removed_count = 0, split_count = 0, triangulated_count = 0, inserted_count = 0;
+		int shell_number = 0;
+		std::vector<int> repaired_shells;
+		for (auto& obj : f.objects)
+		{
+			for (auto& shell : obj.shells)
+			{
+				shell_number += 1;
+				unsigned long removed = 0, split = 0, triangulated = 0;
+				std::vector<unsigned long> loose; // vertices of the removed faces
+				std::vector<Face> repaired_faces;
+				for (auto& face : shell.faces)
+				{
+					std::vector<unsigned long> indices;
+					for (auto& indice : face.v_new_indices) {
+						unsigned long id = merged_id[indice];
+						if (indices.empty() || indices.back() != id) indices.emplace_back(id);
+					}
+					while (indices.size() > 1 && indices.front() == indices.back()) indices.pop_back();
+
+					std::vector<std::vector<unsigned long>> rings = split_ring(indices);
+					if (rings.size() > 1) ++split;
+					for (auto& ring : rings) {
+						std::vector<LatticePoint> points;
+						for (auto& id : ring) points.emplace_back(lattice_points[id]);
+
+						if (ring.size() < 3 || collinear_face(points)) {
+							++removed;
+							loose.insert(loose.end(), ring.begin(), ring.end());
+							continue;
+						}
+
+						if (!planar_face(points)) {
+							++triangulated;
+							for (auto& triangle : triangulate(ring, points)) {
+								face.v_new_indices = triangle;
+								repaired_faces.emplace_back(face);
+							}
+							continue;
+						}
+
+						face.v_new_indices = ring;
+						repaired_faces.emplace_back(face);
+					}
+				}
+
+				std::size_t inserted = 0;
+				if (!loose.empty()) {
+					std::sort(loose.begin(), loose.end());
+					loose.erase(std::unique(loose.begin(), loose.end()), loose.end());
+					inserted = insert_on_edges(repaired_faces, loose, lattice_points);
+				}
+				shell.faces = repaired_faces;
+
+				if (removed != 0 || split != 0 || triangulated != 0) {
+					repaired_shells.emplace_back(shell_number);
+					std::cout << "shell " << shell_number << ": " << removed << " degenerated faces removed, " << split << " faces split, "
+						<< triangulated << " non-planar faces triangulated, " << inserted << " vertices inserted into edges" << '\n';
+				}
+				removed_count += removed;
+				split_count += split;
+				triangulated_count += triangulated;
+				inserted_count += (unsigned long)inserted;
+			}
+		}
+
+		std::cout << "vertices merged by snapping: " << merged_count << '\n';
+		std::cout << "degenerated faces removed: " << removed_count << ", faces split: " << split_count
+			<< ", non-planar faces triangulated: " << triangulated_count << ", vertices inserted into edges: " << inserted_count << '\n';
+		std::cout << "shells repaired: " << repaired_shells.size() << '\n';
+		Instrumentation::gauge("snap.merged_vertices", (double)merged_count);
+		Instrumentation::gauge("snap.repaired_shells", (double)repaired_shells.size());
+	}
+};
+
+
 // prepare vertices and faces for creating polyhedron
 // use shell.vertices and face.v_poly_indices
 class PreparePolyhedron {
@@ -722,6 +1076,7 @@ public:
 	* shell.faces -> face.v_poly_indices: point to shell.poly_vertices -- 0 based NOT 1 based
 	*/
 	static void prepare_poly_vertices_face_indices(OBJFile& f) {
+		Scoped_timer timer("prepare_poly_vertices_face_indices");
 		for (auto& obj : f.objects)
 		{
 			for (auto& shell : obj.shells)
@@ -760,8 +1115,10 @@ public:
 
 	/*
 	* test: output each shell as one .obj file
+	* folder: subfolder of the intermediate folder for the shells, ie "/bench" (it must exist), empty for the folder itself
 	*/
-	static void output_each_shell(OBJFile& f) {
+	static void output_each_shell(OBJFile& f, const std::string& folder = "") {
+		Scoped_timer timer("output_each_shell");
 		int shell_id = 0;
 		for (auto& obj : f.objects)
 		{
@@ -772,11 +1129,15 @@ public:
 				std::string prefix = "/";
 				std::string suffix = ".obj";
 				std::string fname = std::to_string(shell_id);
-				std::string filename = path + prefix + fname + suffix;
+				std::string filename = path + folder + prefix + fname + suffix;
 				std::cout << "-- output obj file: " << filename << '\n';
 
 				std::ofstream myfile;
 				myfile.open(filename);
+				if (Snap_Enabled) {
+					// keep every lattice digit, the default precision would round them away
+					myfile << std::fixed << std::setprecision(Snap_Decimals);
+				}
 				for (auto& v : shell.poly_vertices) {
 					myfile << "v" << " " << v.x << " " << v.y << " " << v.z << '\n';
 				}
@@ -792,4 +1153,164 @@ public:
 			}
 		}
 	}
-};
\ No newline at end of file
+};
+
+
+
+// placement of a shell: shell = Rz(-rotation * 90 degrees) * (template + offset)
+struct Template_placement {
+	std::size_t template_id;
+	int rotation; // quarter turns around z, 0..3
+	Vector3d offset;
+};
+
+
+struct Templates {
+	std::vector<std::size_t> representatives; // template -> the first shell it was found in (0-based, shell id - 1)
+	std::vector<std::size_t> instance_counts; // template -> number of shells
+	std::vector<std::vector<Vector3d>> vertices; // canonical vertices of each template
+	std::vector<std::vector<std::vector<unsigned long>>> faces; // faces of each template, index vertices
+	std::vector<Template_placement> placements; // shell -> placement
+};
+
+
+// detect repeated shells (windows, doors, columns ...) and group them into geometry templates
+// each shell is brought into a canonical pose: rotated by 0, 90, 180 or 270 degrees around z and moved to the
+// origin by its bounding box minimum; the pose with the smallest key (the sorted vertices on the Template_Tolerance
+// grid and the faces over them) is kept, and shells with the same key share a template
+class GeometryTemplates {
+private:
+	typedef std::vector<long long> Key;
+
+	struct Key_hash {
+		std::size_t operator()(const Key& key) const {
+			std::size_t h = key.size();
+			for (auto const& v : key) h ^= std::hash<long long>()(v) + 0x9e3779b9 + (h << 6) + (h >> 2);
+			return h;
+		}
+	};
+
+
+	/*
+	* canonical key of a shell in one rotation, offset is set to the bounding box minimum of the rotated shell
+	*/
+	static Key shell_key(const Shell& shell, int rotation, Vector3d& offset) {
+		std::vector<Vector3d> rotated;
+		for (auto const& v : shell.poly_vertices) rotated.push_back(rotate(v, rotation));
+		offset = rotated.empty() ? Vector3d() : rotated[0];
+		for (auto const& v : rotated) {
+			offset.x = std::min(offset.x, v.x);
+			offset.y = std::min(offset.y, v.y);
+			offset.z = std::min(offset.z, v.z);
+		}
+
+		std::vector<std::vector<long long>> grid(rotated.size());
+		for (std::size_t i = 0; i != rotated.size(); ++i) {
+			grid[i] = {
+				std::llround((rotated[i].x - offset.x) / Template_Tolerance),
+				std::llround((rotated[i].y - offset.y) / Template_Tolerance),
+				std::llround((rotated[i].z - offset.z) / Template_Tolerance) };
+		}
+		std::vector<unsigned long> order(grid.size());
+		for (std::size_t i = 0; i != order.size(); ++i) order[i] = (unsigned long)i;
+		std::sort(order.begin(), order.end(), [&](unsigned long a, unsigned long b) { return grid[a] < grid[b]; });
+		std::vector<long long> rank(grid.size());
+		for (std::size_t i = 0; i != order.size(); ++i) rank[order[i]] = (long long)i;
+
+		// faces over the ranks, starting at their smallest rank, in sorted order
+		std::vector<std::vector<long long>> faces;
+		for (auto const& face : shell.faces) {
+			std::vector<long long> ranks;
+			for (auto const& index : face.v_poly_indices) ranks.push_back(rank[index]);
+			if (ranks.empty()) continue;
+			std::rotate(ranks.begin(), std::min_element(ranks.begin(), ranks.end()), ranks.end());
+			faces.push_back(ranks);
+		}
+		std::sort(faces.begin(), faces.end());
+
+		Key key;
+		key.push_back((long long)grid.size());
+		for (auto const& i : order) key.insert(key.end(), grid[i].begin(), grid[i].end());
+		key.push_back((long long)faces.size());
+		for (auto const& face : faces) {
+			key.push_back((long long)face.size());
+			key.insert(key.end(), face.begin(), face.end());
+		}
+		return key;
+	}
+public:
+	/*
+	* rotate a point by a number of quarter turns around z, exact in doubles
+	*/
+	static Vector3d rotate(const Vector3d& v, int quarter_turns) {
+		switch (((quarter_turns % 4) + 4) % 4) {
+		case 1: return Vector3d(-v.y, v.x, v.z);
+		case 2: return Vector3d(-v.x, -v.y, v.z);
+		case 3: return Vector3d(v.y, -v.x, v.z);
+		default: return Vector3d(v.x, v.y, v.z);
+		}
+	}
+
+
+	/*
+	* check if a shell (0-based, shell id - 1) shares its template with other shells
+	* with Templates_Emit, such a shell is written as a GeometryInstance and left out of the union
+	*/
+	static bool is_repeated(const Templates& templates, std::size_t shell) {
+		return shell < templates.placements.size() && templates.instance_counts[templates.placements[shell].template_id] > 1;
+	}
+
+
+	/*
+	* group the shells of f into templates, the shells are numbered as in PreparePolyhedron::output_each_shell
+	* call after PreparePolyhedron::prepare_poly_vertices_face_indices
+	*/
+	static void detect(OBJFile& f, Templates& templates) {
+		std::unordered_map<Key, std::size_t, Key_hash> template_ids;
+
+		std::size_t shell_index = 0;
+		for (auto& obj : f.objects) {
+			for (auto& shell : obj.shells) {
+				Template_placement placement;
+				Key best_key;
+				for (int rotation = 0; rotation != 4; ++rotation) {
+					Vector3d offset;
+					Key key = shell_key(shell, rotation, offset);
+					if (rotation == 0 || key < best_key) {
+						best_key = key;
+						placement.rotation = rotation;
+						placement.offset = offset;
+					}
+				}
+
+				auto it = template_ids.find(best_key);
+				if (it == template_ids.end()) {
+					it = template_ids.emplace(best_key, templates.representatives.size()).first;
+					templates.representatives.push_back(shell_index);
+					templates.instance_counts.push_back(0);
+
+					std::vector<Vector3d> vertices;
+					for (auto const& v : shell.poly_vertices) {
+						Vector3d r = rotate(v, placement.rotation);
+						vertices.emplace_back(r.x - placement.offset.x, r.y - placement.offset.y, r.z - placement.offset.z);
+					}
+					std::vector<std::vector<unsigned long>> faces;
+					for (auto const& face : shell.faces) faces.push_back(face.v_poly_indices);
+					templates.vertices.push_back(vertices);
+					templates.faces.push_back(faces);
+				}
+				placement.template_id = it->second;
+				++templates.instance_counts[it->second];
+				templates.placements.push_back(placement);
+				++shell_index;
+			}
+		}
+
+		std::size_t num_repeated = 0;
+		for (auto const& count : templates.instance_counts) {
+			if (count > 1) ++num_repeated;
+		}
+		std::cout << "geometry templates: " << shell_index << " shells, " << templates.representatives.size()
+			<< " unique, " << num_repeated << " repeated" << '\n';
+	}
+};
@@ -4,22 +4,226 @@
 #include "LoadOBJ.hpp"
 
 
+#include <CGAL/version.h>
 #include <CGAL/Exact_predicates_exact_constructions_kernel.h>
+#include <CGAL/Exact_predicates_inexact_constructions_kernel.h>
+#include <CGAL/Simple_cartesian.h>
+#include <CGAL/Homogeneous.h>
+#include <CGAL/Exact_rational.h>
+#include <CGAL/Exact_integer.h>
 #include <CGAL/Polyhedron_3.h>
 #include <CGAL/Polyhedron_incremental_builder_3.h>
 #include <CGAL/Nef_polyhedron_3.h>
 #include <CGAL/convex_hull_3.h>
 #include <CGAL/minkowski_sum_3.h>
+#include <CGAL/convex_decomposition_3.h>
+#include <CGAL/Unique_hash_map.h>
+#include <CGAL/Handle_hash_function.h>
+#include <CGAL/Surface_mesh.h>
+#include <CGAL/boost/graph/convert_nef_polyhedron_to_polygon_mesh.h>
+#include <CGAL/Polygon_mesh_processing/connected_components.h>
+
+#include <algorithm>
+#include <thread>
+#include <set>
+#include <limits>
+#include <unordered_map>
+#include <array>
+#include <mutex>
+#include <exception>
+
+
+// kernel policy -- the exact kernel used for the polyhedra, the Nef polyhedra and the extraction
+template <class K>
+struct Kernel_policy {
+    typedef K Kernel;
+    typedef typename K::Point_3 Point;
+    typedef CGAL::Polyhedron_3<K> Polyhedron;
+    typedef CGAL::Nef_polyhedron_3<K> Nef_polyhedron;
+};
 
+struct Epeck_policy : public Kernel_policy<CGAL::Exact_predicates_exact_constructions_kernel> {
+    static const char* name() { return "EPECK"; }
+};
 
-typedef CGAL::Exact_predicates_exact_constructions_kernel Kernel;
-typedef Kernel::Point_3 Point;
-typedef CGAL::Polyhedron_3<Kernel> Polyhedron;
-typedef CGAL::Nef_polyhedron_3<Kernel> Nef_polyhedron;
+struct Cartesian_rational_policy : public Kernel_policy<CGAL::Simple_cartesian<CGAL::Exact_rational>> {
+    static const char* name() { return "Simple_cartesian<Exact_rational>"; }
+};
+
+// integer coordinates with a common denominator, pairs with snap rounding
+struct Homogeneous_integer_policy : public Kernel_policy<CGAL::Homogeneous<CGAL::Exact_integer>> {
+    static const char* name() { return "Homogeneous<Exact_integer>"; }
+};
+
+// the kernel of the conversion pipeline, chosen at build time -- see BIMCONVERT_KERNEL in CMakeLists.txt
+#if defined(BIMCONVERT_KERNEL_CARTESIAN_RATIONAL)
+typedef Cartesian_rational_policy Policy;
+#elif defined(BIMCONVERT_KERNEL_HOMOGENEOUS_INTEGER)
+typedef Homogeneous_integer_policy Policy;
+#else
+typedef Epeck_policy Policy;
+#endif
+
+typedef Policy::Kernel Kernel;
+typedef Policy::Point Point;
+typedef Policy::Polyhedron Polyhedron;
+typedef Policy::Nef_polyhedron Nef_polyhedron;
+
+// convex hulls only need exact predicates, the hull is computed on doubles
+typedef CGAL::Exact_predicates_inexact_constructions_kernel Hull_kernel;
+typedef Hull_kernel::Point_3 Hull_point;
+typedef CGAL::Polyhedron_3<Hull_kernel> Hull_polyhedron;
+
+// double coordinates of an exact point, for the stages after extraction
+typedef std::array<double, 3> Approx_point;
+
+// gap closing offset -- minkowski sum of a shell with a small structuring element
+enum class Offset_Shape { CUBE, OCTAHEDRON };
+enum class Offset_Mode {
+    EXACT,       // CGAL::minkowski_sum_3
+    CONVEX_PARTS // approximate: convex decomposition, hull of each offset part on doubles, union
+};
+const bool Offset_Enabled = false;
+const double Offset_Radius = 0.001; // half size of the structuring element, in model units
+const Offset_Shape Offset_Element = Offset_Shape::CUBE;
+const Offset_Mode Offset_Method = Offset_Mode::EXACT;
+
+// extraction of the shells of the big nef
+enum class Extraction_Mode {
+    VISITOR,     // Shell_explorer over the shells of every volume, in volume order
+    SURFACE_MESH // CGAL::convert_nef_polyhedron_to_polygon_mesh, one shell per connected component
+};
+const Extraction_Mode Extraction_Method = Extraction_Mode::VISITOR;
+
+// role of an extracted shell, see ExtractGeometries::classify_volume
+enum class Shell_Type {
+    EXTERIOR, // boundary between the building and the unbounded outside
+    ROOM,     // outer shell of an empty bounded volume
+    VOID,     // as a room, but enclosing less than Void_Volume
+    SOLID     // other shells: boundaries of the building material seen from inside it, objects inside rooms
+};
+const double Void_Volume = 0.001; // in cubic model units
+
+
+/*
+* convert an exact number to double
+* the interval approximation is used when it pins the double down,
+* otherwise CGAL::to_double refines it, computing the exact value only if needed
+*/
+template <class NT>
+double approximate(const NT& value) {
+    std::pair<double, double> interval = CGAL::to_interval(value);
+    if (interval.first == interval.second) return interval.first;
+    return CGAL::to_double(value);
+}
+
+
+// the parallel stages share lazy exact numbers and reference counted Nef polyhedra between threads,
+// which is thread safe from CGAL 5.5 on (CGAL_VERSION_NR 1050500000); with an older CGAL they run on one thread
+#if CGAL_VERSION_NR >= 1050500000
+const bool Parallel_Enabled = true;
+#else
+const bool Parallel_Enabled = false;
+#endif
+
+
+/*
+* run job(i) for every i in [0, count), round robin over the hardware threads
+* an exception thrown by a job stops its thread, the first one is rethrown once all threads are joined
+* return: the number of threads used
+*/
+template <class Job>
+std::size_t parallel_for(std::size_t count, Job job) {
+    std::size_t num_threads = Parallel_Enabled ? std::max(1u, std::thread::hardware_concurrency()) : 1;
+    if (num_threads > count) num_threads = count;
+
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    std::vector<std::thread> workers;
+    for (std::size_t t = 0; t != num_threads; ++t) {
+        workers.emplace_back([&, t]() {
+            try {
+                for (std::size_t i = t; i < count; i += num_threads) job(i);
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error) error = std::current_exception();
+            }
+        });
+    }
+    for (auto& worker : workers) worker.join();
+    if (error) std::rethrow_exception(error);
+    return num_threads;
+}
+
+
+/*
+* 2^n as an exact number, n >= 0, multiplied in steps that stay in the range of a double
+*/
+template <class RT>
+RT power_of_two(int n) {
+    RT power(1);
+    for (; n > 0; n -= 1000) power *= RT(std::ldexp(1.0, std::min(n, 1000)));
+    return power;
+}
+
+
+/*
+* c * 2^k as an exact number, c * 2^k must be an integer
+* c = m * 2^(e - 53) with an integer m, which is scaled exactly even when c * 2^k overflows a double
+*/
+template <class RT>
+RT scaled_integer(double c, int k) {
+    if (c == 0) return RT(0);
+    const int digits = std::numeric_limits<double>::digits;
+    int e;
+    double m = std::frexp(c, &e);
+    int shift = e - digits + k;
+    if (shift < 0) return RT(std::ldexp(c, k)); // |c * 2^k| < 2^53, an exact double
+    return RT(std::ldexp(m, digits)) * power_of_two<RT>(shift);
+}
+
+
+/*
+* construct an exact point from the coordinates read from an obj shell
+* with snap rounding, the coordinates are lattice indices over the common denominator Snap_Scale
+* thus the kernel stores small exact rationals instead of the full binary expansion of each double
+* without snap rounding, each double is written exactly as an integer over a power of two,
+* which every kernel (also the homogeneous ones) can represent
+* (the power of two exceeds the range of a double for tiny coordinates, it is built by power_of_two)
+*/
+template <class Policy>
+typename Policy::Point make_point(double x, double y, double z) {
+    typedef typename Policy::Kernel::RT RT;
+    typedef typename Policy::Point Point;
+    if (Snap_Enabled) {
+        return Point(
+            RT(std::round(x * Snap_Scale)),
+            RT(std::round(y * Snap_Scale)),
+            RT(std::round(z * Snap_Scale)),
+            RT(Snap_Scale));
+    }
+
+    // common denominator 2^k, such that x * 2^k, y * 2^k and z * 2^k are integers
+    int k = 0;
+    for (double c : { x, y, z }) {
+        if (c == 0) continue;
+        int e;
+        std::frexp(c, &e); // c = m * 2^e, m has 53 significant bits
+        k = std::max(k, std::numeric_limits<double>::digits - e);
+    }
+    return Point(
+        scaled_integer<RT>(x, k),
+        scaled_integer<RT>(y, k),
+        scaled_integer<RT>(z, k),
+        power_of_two<RT>(k));
+}
 
 
 template <class HDS>
 struct Polyhedron_builder : public CGAL::Modifier_base<HDS> {
+    typedef typename HDS::Vertex::Point Point;
+
     std::vector<Point> vertices; // type: Kernel::Point_3, for EACH SHELL
     std::vector<std::vector<unsigned long>> faces; // INDEX for vertices in EACH SHELL
 
@@ -37,52 +241,58 @@ struct Polyhedron_builder : public CGAL::Modifier_base<HDS> {
 
 
 // help to store the nef_polyhedron_list
+template <class Policy>
 struct Nef {
+    typedef typename Policy::Nef_polyhedron Nef_polyhedron;
+
     std::vector<Nef_polyhedron> nef_polyhedron_list; // store all Nef polyhedrons
     Nef_polyhedron big_nef; // store the big nef
 };
 
 
 // build nef polyhedra from(polyhedron builder and convex hull)
+template <class Policy>
 class Build_Nef_Polyhedron {
 private:
-    /*
-    * check if a vertex already exists in a vertices vector
-    * USE coordinates not indices to compare whether two vertices are the same
-    * return: False - not exist, True - exist
-    */
-    static bool vertex_exist_check(std::vector<Point>& vertices, Point& vertex) {
-        bool flag(false);
-        for (auto& v : vertices) {
-            if (
-                abs(vertex.x() - v.x()) < Epsilon &&
-                abs(vertex.y() - v.y()) < Epsilon &&
-                abs(vertex.z() - v.z()) < Epsilon) {
-
-                flag = true;
-            }
-        }
-        return flag;
-    }
-
+    typedef typename Policy::Polyhedron Polyhedron;
+    typedef typename Policy::Nef_polyhedron Nef_polyhedron;
+public:
 
     /*
-    * if a vertex is repeated, find the index and return
+    * compute the convex hull of points with the inexact constructions kernel
+    * points are deduplicated first, and only the final hull vertices are converted to the exact kernel
+    * poly: the hull as an exact polyhedron, ready for the Nef_polyhedron constructor
+    * return: False - the hull is degenerated (ie coplanar points), True - poly is a closed hull
     */
-    static unsigned long find_vertex(std::vector<Point>& vertices, Point& vertex) {
-        for (std::size_t i = 0; i != vertices.size(); ++i) {
-            if (
-                abs(vertex.x() - vertices[i].x()) < Epsilon &&
-                abs(vertex.y() - vertices[i].y()) < Epsilon &&
-                abs(vertex.z() - vertices[i].z()) < Epsilon) {
-
-                return (unsigned long)i;
+    static bool convex_hull_polyhedron(std::vector<Hull_point>& points, Polyhedron& poly) {
+        std::sort(points.begin(), points.end());
+        points.erase(std::unique(points.begin(), points.end()), points.end());
+
+        Hull_polyhedron hull;
+        CGAL::convex_hull_3(points.begin(), points.end(), hull);
+        if (!hull.is_closed()) return false;
+
+        // hull vertices -> index in polyhedron_builder.vertices
+        Polyhedron_builder<typename Polyhedron::HalfedgeDS> polyhedron_builder;
+        CGAL::Unique_hash_map<Hull_polyhedron::Vertex_const_handle, unsigned long> vertex_index;
+        for (auto v = hull.vertices_begin(); v != hull.vertices_end(); ++v) {
+            vertex_index[v] = (unsigned long)polyhedron_builder.vertices.size();
+            polyhedron_builder.vertices.emplace_back(
+                make_point<Policy>(v->point().x(), v->point().y(), v->point().z()));
+        }
+        for (auto facet = hull.facets_begin(); facet != hull.facets_end(); ++facet) {
+            polyhedron_builder.faces.emplace_back();
+            Hull_polyhedron::Halfedge_around_facet_const_circulator hc_start = facet->facet_begin();
+            Hull_polyhedron::Halfedge_around_facet_const_circulator hc_end = hc_start;
+            CGAL_For_all(hc_start, hc_end) {
+                polyhedron_builder.faces.back().push_back(vertex_index[hc_start->vertex()]);
             }
         }
-        std::cout << "warning: please check find_vertex function" << '\n';
-        return 0;
+
+        poly.delegate(polyhedron_builder);
+        return poly.is_closed();
     }
-public:
+
 
     /*
     * compute convex hull for shells which don't work for polyhedron builder
@@ -98,7 +308,7 @@ public:
         if (!file.is_open()) { std::cerr << "file open failed! " << '\n'; }
      
         std::vector<double> coordinates; // store xyz coordinates of each vertex line
-        std::vector<Point> vertices;
+        std::vector<Hull_point> vertices;
 
         // process each line in the obj file
         while (std::getline(file, line)) {
@@ -139,7 +349,7 @@ public:
             // process each vertex (if it's a vertex line)
             if (!coordinates.empty() && coordinates.size() == 3) {
                 vertices.emplace_back(
-                    Point(
+                    Hull_point(
                         coordinates[0], // x
                         coordinates[1], // y
                         coordinates[2]) // z
@@ -149,14 +359,9 @@ public:
 
         } // end while: each line in the file
 
-        // use Point_3 points in vertices to compute the convex hull
-        
-        // define polyhedron to hold convex hull
+        // use Hull_point points in vertices to compute the convex hull
         Polyhedron poly;
-        // compute convex hull of non-collinear points
-        CGAL::convex_hull_3(vertices.begin(), vertices.end(), poly);
-        //std::cout << "The convex hull contains " << poly.size_of_vertices() << " vertices" << '\n';
-        if (poly.is_closed()) {
+        if (convex_hull_polyhedron(vertices, poly)) {
             // convert the poly to nef_poly and add it to nef
             std::cout << " build convex hull " << '\n';
             Nef_polyhedron nef_poly(poly);
@@ -186,7 +391,7 @@ public:
         std::vector<double> coordinates; // store xyz coordinates of each vertex line
         std::vector<unsigned long> face_v_indices; // store face-vertex indices in each face line
 
-        Polyhedron_builder<Polyhedron::HalfedgeDS> polyhedron_builder; // construct polyhedron_builder
+        Polyhedron_builder<typename Polyhedron::HalfedgeDS> polyhedron_builder; // construct polyhedron_builder
 
         // process each line in the obj file
         while (std::getline(file, line)) {
@@ -230,7 +435,7 @@ public:
             // process each vertex (if it's a vertex line)
             if (!coordinates.empty() && coordinates.size() == 3) {
                 polyhedron_builder.vertices.emplace_back(
-                    Point(
+                    make_point<Policy>(
                         coordinates[0], // x
                         coordinates[1], // y
                         coordinates[2]) // z
@@ -263,17 +468,99 @@ public:
     }
 
 
+    /*
+    * number of Nef polyhedra and their vertices, for the instrumentation report
+    */
+    static void count_nef_polyhedra(const Nef<Policy>& nef) {
+        std::size_t num_vertices = 0;
+        for (auto const& nef_poly : nef.nef_polyhedron_list) num_vertices += nef_poly.number_of_vertices();
+        Instrumentation::gauge("nef.polyhedra", (double)nef.nef_polyhedron_list.size());
+        Instrumentation::gauge("nef.vertices", (double)num_vertices);
+    }
+
+
+    // Nef polyhedra of the template representatives: (template, built by convex hull) -> (Nef polyhedron, shell id)
+    typedef std::map<std::pair<std::size_t, bool>, std::pair<Nef_polyhedron, int>> Template_cache;
+
+
+    /*
+    * transformation moving the shell placed by from onto the shell placed by to, see Template_placement:
+    * v -> Rz(from.rotation - to.rotation) v + Rz(-to.rotation) (to.offset - from.offset)
+    * the rotation is exact, the translation is a lattice vector with snap rounding
+    */
+    static typename Policy::Kernel::Aff_transformation_3 placement_transformation(
+        const Template_placement& from, const Template_placement& to) {
+        typedef typename Policy::Kernel::RT RT;
+        typedef typename Policy::Kernel::Aff_transformation_3 Aff_transformation;
+        static const int cosines[4] = { 1, 0, -1, 0 };
+        static const int sines[4] = { 0, 1, 0, -1 };
+
+        int quarter_turns = ((from.rotation - to.rotation) % 4 + 4) % 4;
+        RT c(cosines[quarter_turns]), s(sines[quarter_turns]), zero(0), one(1);
+        Aff_transformation rotation(c, -s, zero, s, c, zero, zero, zero, one, one);
+
+        Vector3d d(to.offset.x - from.offset.x, to.offset.y - from.offset.y, to.offset.z - from.offset.z);
+        Vector3d t = GeometryTemplates::rotate(d, -to.rotation);
+        Aff_transformation translation(CGAL::TRANSLATION, make_point<Policy>(t.x, t.y, t.z) - CGAL::ORIGIN);
+        return translation * rotation;
+    }
+
+
+    /*
+    * build the Nef polyhedron of <shell_id>.obj, by convex hull or by the polyhedron builder
+    * hull_if_empty: use the convex hull if the polyhedron builder gives an empty Nef polyhedron (the shell is not closed)
+    * folder: subfolder of the intermediate folder holding the shells, see PreparePolyhedron::output_each_shell
+    * with templates, a shell repeating an earlier shell is a transformed copy of its Nef polyhedron (Templates_Enabled,
+    * with Snap_Enabled only); only the Nef polyhedron used for the earlier shell is cached, under the method which built it
+    * with Templates_Emit, a repeated shell is written as a geometry instance and its Nef polyhedron is empty
+    */
+    static Nef_polyhedron build_shell(int shell_id, bool convex_hull, const Templates* templates, Template_cache& cache,
+        bool hull_if_empty = false, const std::string& folder = "") {
+        std::string shell_name = folder + "/" + std::to_string(shell_id) + ".obj";
+        if (Templates_Emit && templates != nullptr && shell_id >= 1 && GeometryTemplates::is_repeated(*templates, (std::size_t)shell_id - 1)) {
+            std::cout << "skipping shell: " << shell_name << ", it is written as a geometry instance" << '\n';
+            return Nef_polyhedron(Nef_polyhedron::EMPTY);
+        }
+        bool built_by_hull = convex_hull;
+        auto build = [&]() {
+            if (convex_hull) return build_convexhull(shell_name);
+            Nef_polyhedron nef_poly = build_polyhedron_each_shell(shell_name);
+            if (!nef_poly.is_empty() || !hull_if_empty) return nef_poly;
+            built_by_hull = true;
+            return build_convexhull(shell_name);
+        };
+        if (!Templates_Enabled || !Snap_Enabled || templates == nullptr || shell_id < 1 || (std::size_t)shell_id > templates->placements.size()) {
+            return build();
+        }
+
+        const Template_placement& placement = templates->placements[shell_id - 1];
+        auto it = cache.find(std::make_pair(placement.template_id, convex_hull));
+        if (it == cache.end() && !convex_hull && hull_if_empty) it = cache.find(std::make_pair(placement.template_id, true));
+        if (it == cache.end()) {
+            Nef_polyhedron nef_poly = build();
+            cache.emplace(std::make_pair(placement.template_id, built_by_hull), std::make_pair(nef_poly, shell_id));
+            return nef_poly;
+        }
+
+        int representative = it->second.second;
+        std::cout << "placing shell: " << shell_name << " as a copy of shell " << representative << '\n';
+        Nef_polyhedron nef_poly = it->second.first;
+        nef_poly.transform(placement_transformation(templates->placements[representative - 1], placement));
+        return nef_poly;
+    }
+
+
     /*
     * build polyhedra from polyhedron builder and convexhull
     * for 1~17.obj files, use polyhedron builder to build polyhedra
     * for 18~33.obj files, use the corresponding convex hull to build polyhedra and store the polyhedra as .off files
+    * templates (optional): shells sharing a template are built once, see build_shell
+    * folder (optional): subfolder of the intermediate folder holding the shells
     */
-    static void build_nef_polyhedra(Nef& nef) {
+    static void build_nef_polyhedra(Nef<Policy>& nef, const Templates* templates = nullptr, const std::string& folder = "") {
+        Scoped_timer timer("build_nef_polyhedra");
+        Template_cache cache;
 
-        // common file prefix and suffix for obj files
-        std::string prefix = "/";
-        std::string suffix_obj = ".obj";
-     
         //std::cout << "-- reading 1.obj to 17.obj, these shells can be passed to polyhedron builder" << '\n';
         //std::cout << "-- reading 18.obj to 33.obj, use these shells' convex hull to build corresponding polyhedron" << '\n';
 
@@ -282,25 +569,18 @@ public:
             //if (shell_id == 5)continue;
             if ( shell_id == 2 || shell_id == 12 || shell_id == 3 ||
                 shell_id == 4  || shell_id == 14 || shell_id == 1 || shell_id == 1) {
-                std::string shell_str = std::to_string(shell_id);
-                std::string shell_name = prefix + shell_str + suffix_obj;
-                Nef_polyhedron nef_poly = build_convexhull(shell_name);
+                Nef_polyhedron nef_poly = build_shell(shell_id, true, templates, cache, false, folder);
                 nef.nef_polyhedron_list.push_back(nef_poly);
                 
             }
             else if(shell_id == 16 || shell_id == 17){
-                std::string shell_str = std::to_string(shell_id);
-                std::string shell_name = prefix + shell_str + suffix_obj;
-                Nef_polyhedron nef_poly = build_polyhedron_each_shell(shell_name);            
+                Nef_polyhedron nef_poly = build_shell(shell_id, false, templates, cache, false, folder);            
                 
-                //std::string fcube = "/cube1.obj"; // used for miniskow_sum
-                //Nef_polyhedron nef_poly_miniskow = miniskow_sum(fcube, nef_poly);
+                // gaps around these shells can be closed by GapOffset::offset_nef_polyhedra
                 nef.nef_polyhedron_list.push_back(nef_poly);
             }
             else {
-                std::string shell_str = std::to_string(shell_id);
-                std::string shell_name = prefix + shell_str + suffix_obj;
-                Nef_polyhedron nef_poly = build_polyhedron_each_shell(shell_name);
+                Nef_polyhedron nef_poly = build_shell(shell_id, false, templates, cache, false, folder);
                 nef.nef_polyhedron_list.push_back(nef_poly);
             }           
         }
@@ -311,151 +591,303 @@ public:
                 shell_id == 23 || shell_id == 25 || shell_id == 26 || shell_id == 27 ||
                 shell_id == 28 || shell_id == 18 || shell_id == 33 || shell_id == 20 || shell_id == 24)continue;
 
-            std::string shell_str = std::to_string(shell_id);
-            std::string shell_name = prefix + shell_str + suffix_obj;
-
-            Nef_polyhedron nef_poly = build_convexhull(shell_name);
+            Nef_polyhedron nef_poly = build_shell(shell_id, true, templates, cache, false, folder);
             nef.nef_polyhedron_list.push_back(nef_poly);        
         }
       
         // output nef_polyhedron_list size
         std::cout << "build " << nef.nef_polyhedron_list.size() << " " << "Nef polyhedra" << '\n';
+        count_nef_polyhedra(nef);
     }
 
 
-    static Nef_polyhedron miniskow_sum(std::string& fcube, Nef_polyhedron& nef_polyhedron) {
-        std::string path = INTER_PATH;
-        std::string filename = path + fcube;
+    /*
+    * build the Nef polyhedra of 1.obj to <shell_count>.obj, for inputs other than KIT.obj (ie shells loaded from an ifc file)
+    * each shell is passed to the polyhedron builder, its convex hull is used if it is not closed
+    * folder (optional): subfolder of the intermediate folder holding the shells
+    */
+    static void build_nef_polyhedra_each_shell(Nef<Policy>& nef, int shell_count, const Templates* templates = nullptr,
+        const std::string& folder = "") {
+        Scoped_timer timer("build_nef_polyhedra");
+        Template_cache cache;
+        for (int shell_id = 1; shell_id <= shell_count; ++shell_id) {
+            nef.nef_polyhedron_list.push_back(build_shell(shell_id, false, templates, cache, true, folder));
+        }
+        std::cout << "build " << nef.nef_polyhedron_list.size() << " " << "Nef polyhedra" << '\n';
+        count_nef_polyhedra(nef);
+    }
+};
 
-        // read obj
-        std::string line;
-        std::ifstream file(filename);
-        if (!file.is_open()) { std::cerr << "file open failed! " << '\n'; }
-        unsigned long vertex_index = 1; // track vertex index in obj file, starts from 1	   
-        std::vector<double> coordinates; // store xyz coordinates of each vertex line
-        std::vector<unsigned long> face_v_indices; // store face-vertex indices in each face line
 
-        Polyhedron_builder<Polyhedron::HalfedgeDS> polyhedron_builder; // construct polyhedron_builder
+// close tiny gaps between IFC elements by offsetting their Nef polyhedra
+// the structuring element is built in memory from Offset_Radius, once per thread
+template <class Policy>
+class GapOffset {
+private:
+    typedef typename Policy::Polyhedron Polyhedron;
+    typedef typename Policy::Nef_polyhedron Nef_polyhedron;
 
-        // process each line in the obj file
-        while (std::getline(file, line)) {
-            if (line.empty()) {
-                continue; // skip empty lines:
-            }
+    /*
+    * vertices and faces(outward oriented) of the structuring element, centered at the origin
+    */
+    static void structuring_element_geometry(
+        std::vector<std::vector<double>>& vertices, std::vector<std::vector<unsigned long>>& faces) {
+        const double r = Offset_Radius;
+        if (Offset_Element == Offset_Shape::CUBE) {
+            vertices = {
+                { -r, -r, -r }, { r, -r, -r }, { r, r, -r }, { -r, r, -r },
+                { -r, -r, r }, { r, -r, r }, { r, r, r }, { -r, r, r } };
+            faces = {
+                { 0, 3, 2, 1 }, { 4, 5, 6, 7 }, { 0, 1, 5, 4 },
+                { 1, 2, 6, 5 }, { 2, 3, 7, 6 }, { 3, 0, 4, 7 } };
+        }
+        else {
+            vertices = {
+                { r, 0, 0 }, { -r, 0, 0 }, { 0, r, 0 }, { 0, -r, 0 }, { 0, 0, r }, { 0, 0, -r } };
+            faces = {
+                { 0, 2, 4 }, { 2, 1, 4 }, { 1, 3, 4 }, { 3, 0, 4 },
+                { 2, 0, 5 }, { 1, 2, 5 }, { 3, 1, 5 }, { 0, 3, 5 } };
+        }
+    }
 
-            // use markers below to mark the type of each line
-            bool v_flag(false); // entitled "v"
-            bool f_flag(false); // entitled "f"
 
-            // help to process elements in each line
-            std::stringstream ss(line);
-            std::string field; // element in each line
-            std::string::size_type sz; // NOT std::size_t, size of std::string
+    static Nef_polyhedron build_structuring_element() {
+        std::vector<std::vector<double>> vertices;
+        std::vector<std::vector<unsigned long>> faces;
+        structuring_element_geometry(vertices, faces);
 
-            // for each element(field, type: string) in one line
-            while (std::getline(ss, field, ' ')) {
+        Polyhedron_builder<typename Polyhedron::HalfedgeDS> polyhedron_builder;
+        for (auto const& v : vertices) polyhedron_builder.vertices.emplace_back(make_point<Policy>(v[0], v[1], v[2]));
+        polyhedron_builder.faces = faces;
 
-                // get the type of current line
-                if (field == "f") {
-                    f_flag = true;
-                    continue;
-                }
-                else if (field == "v") {
-                    v_flag = true;
-                    continue;
-                }
+        Polyhedron polyhedron;
+        polyhedron.delegate(polyhedron_builder);
+        if (polyhedron.is_closed()) {
+            Nef_polyhedron nef_element(polyhedron);
+            return nef_element;
+        }
 
-                // process the current line
-                if (v_flag) {
-                    // process xyz coordinates
-                    coordinates.emplace_back(std::stod(field, &sz));
-                }
-                else if (f_flag) {
-                    face_v_indices.emplace_back((unsigned long)std::stoi(field, &sz) - 1);
-                }
+        std::cout << "warning: please check the build_structuring_element function" << '\n';
+        Nef_polyhedron N0(Nef_polyhedron::EMPTY);
+        return N0;
+    }
 
-            } // end while: process each element in one line
 
-            // process each vertex (if it's a vertex line)
-            if (!coordinates.empty() && coordinates.size() == 3) {
-                polyhedron_builder.vertices.emplace_back(
-                    Point(
-                        coordinates[0], // x
-                        coordinates[1], // y
-                        coordinates[2]) // z
-                );
-                ++vertex_index; // vertex index in obj file
+    /*
+    * the cached structuring element
+    * Nef polyhedra share their representation without locking, so each thread keeps its own copy
+    */
+    static const Nef_polyhedron& structuring_element() {
+        static thread_local Nef_polyhedron element = build_structuring_element();
+        return element;
+    }
+
+
+    /*
+    * approximate offset: decompose the shell into convex parts, the offset of each convex part is
+    * the convex hull of its vertices translated by every vertex of the structuring element
+    * the hulls are computed on doubles and united, no exact minkowski sum is needed
+    */
+    static Nef_polyhedron offset_convex_parts(Nef_polyhedron& nef_polyhedron) {
+        std::vector<std::vector<double>> element_vertices;
+        std::vector<std::vector<unsigned long>> element_faces;
+        structuring_element_geometry(element_vertices, element_faces);
+
+        // convex_decomposition_3 works in place, regularization gives it a representation of its own
+        Nef_polyhedron decomposed = nef_polyhedron.regularization();
+        CGAL::convex_decomposition_3(decomposed);
+
+        Nef_polyhedron result(Nef_polyhedron::EMPTY);
+        typename Nef_polyhedron::Volume_const_iterator ci = ++decomposed.volumes_begin(); // skip the outer volume
+        for (; ci != decomposed.volumes_end(); ++ci) {
+            if (!ci->mark()) continue;
+
+            Polyhedron part;
+            decomposed.convert_inner_shell_to_polyhedron(ci->shells_begin(), part);
+
+            std::vector<Hull_point> points;
+            for (auto v = part.points_begin(); v != part.points_end(); ++v) {
+                double x = CGAL::to_double(v->x());
+                double y = CGAL::to_double(v->y());
+                double z = CGAL::to_double(v->z());
+                for (auto const& e : element_vertices) {
+                    points.emplace_back(x + e[0], y + e[1], z + e[2]);
+                }
             }
-            coordinates.clear();
 
-            // constrcut face and add it into faces (if it's a face line)
-            if (!face_v_indices.empty()) {
-                polyhedron_builder.faces.emplace_back(face_v_indices);
+            Polyhedron hull;
+            if (Build_Nef_Polyhedron<Policy>::convex_hull_polyhedron(points, hull)) {
+                result += Nef_polyhedron(hull);
             }
-            face_v_indices.clear();
+        }
+        return result;
+    }
+public:
 
-        } // end while: each line in the file
+    /*
+    * offset one Nef polyhedron by the structuring element, according to Offset_Method
+    */
+    static Nef_polyhedron offset(Nef_polyhedron& nef_polyhedron) {
+        if (nef_polyhedron.is_empty()) return nef_polyhedron;
 
-        // construct polyhedron and convert it to nef ------------------------------------------------------------------
-        Polyhedron polyhedron;
-        polyhedron.delegate(polyhedron_builder);
-        if (polyhedron.is_closed()) {
-            Nef_polyhedron nef_cube(polyhedron);
-            Nef_polyhedron result = CGAL::minkowski_sum_3(nef_polyhedron, nef_cube);
-            return result;
+        if (Offset_Method == Offset_Mode::CONVEX_PARTS) {
+            return offset_convex_parts(nef_polyhedron);
         }
 
+        Nef_polyhedron element = structuring_element();
+        Nef_polyhedron result = CGAL::minkowski_sum_3(nef_polyhedron, element);
+        return result;
+    }
+
+
+    /*
+    * offset all nef polyhedra in the list, the shells are independent and processed in parallel
+    */
+    static void offset_nef_polyhedra(std::vector<Nef_polyhedron>& nef_polyhedron_list) {
+        Scoped_timer timer("offset_nef_polyhedra");
+        std::size_t count = nef_polyhedron_list.size();
+        std::vector<Nef_polyhedron> results(count);
+        std::size_t num_threads = parallel_for(count, [&](std::size_t i) {
+            results[i] = offset(nef_polyhedron_list[i]);
+        });
+        std::cout << "offset " << count << " Nef polyhedra by " << Offset_Radius
+            << " using " << num_threads << " threads" << '\n';
+
+        nef_polyhedron_list = results;
     }
 };
 
 
 // use CSG to build big Nef polyhedron
+template <class Policy>
 class BigNef {
 public:
-    static void test_big(Nef& nef) {
+    static void test_big(Nef<Policy>& nef) {
+        Scoped_timer timer("test_big");
 		
 		for (auto& one_nef : nef.nef_polyhedron_list) {
             nef.big_nef += one_nef;
 		}
+        Instrumentation::gauge("union.vertices", (double)nef.big_nef.number_of_vertices());
+        Instrumentation::gauge("union.facets", (double)nef.big_nef.number_of_facets());
+        Instrumentation::gauge("union.volumes", (double)nef.big_nef.number_of_volumes());
 		//std::cout << "is simple: " << nef.big_nef.is_simple() << '\n';
 		//std::cout << "num of vertices of the Nef after operation: " << nef.big_nef.number_of_vertices() << '\n';
         
     }
 
 
+    /*
+    * regularize the big nef after the union: drop the lower dimensional leftovers where elements only touch,
+    * ie isolated vertices and edges, and facets which bound no volume
+    * NB: this does not merge coplanar facets, the boolean operations already keep the facets maximal;
+    * the faces of the output are merged after the extraction, see SimplifyShell
+    */
+    static void regularize(Nef<Policy>& nef) {
+        Scoped_timer timer("regularize");
+        std::cout << "num of vertices before regularization: " << nef.big_nef.number_of_vertices() << '\n';
+        std::cout << "num of facets before regularization: " << nef.big_nef.number_of_facets() << '\n';
+        nef.big_nef = nef.big_nef.regularization();
+        std::cout << "num of vertices after regularization: " << nef.big_nef.number_of_vertices() << '\n';
+        std::cout << "num of facets after regularization: " << nef.big_nef.number_of_facets() << '\n';
+        Instrumentation::gauge("regularize.vertices", (double)nef.big_nef.number_of_vertices());
+        Instrumentation::gauge("regularize.facets", (double)nef.big_nef.number_of_facets());
+    }
 };
 
 
 // extract geometries
+// each Nef vertex of the shell is emitted once, faces index the vertices of this shell
+template <class Policy>
 struct Shell_explorer {
+    typedef typename Policy::Point Point;
+    typedef typename Policy::Nef_polyhedron Nef_polyhedron;
+    typedef typename Nef_polyhedron::Vertex_const_handle Vertex_const_handle;
+
     std::vector<Point> vertices;
     std::vector<std::vector<unsigned long>> faces;
+    std::unordered_map<Vertex_const_handle, unsigned long, CGAL::Handle_hash_function> vertex_indices; // Nef vertex -> index in vertices
+    std::vector<Approx_point> coordinates; // double coordinates of vertices, filled by convert_coordinates
+    std::size_t extracted_vertices = 0;   // counts as extracted, before SimplifyShell
+    std::size_t extracted_faces = 0;
+
+    // classification, filled during extraction
+    std::size_t volume_index = 0; // the volume of the big nef this shell belongs to
+    bool volume_mark = false;
+    bool outer = false;           // outer shell of a bounded volume
+    double signed_volume = 0;     // enclosed volume, positive if the faces point out of the enclosed region
+    Shell_Type type = Shell_Type::SOLID;
 
-    void visit(Nef_polyhedron::Vertex_const_handle v) {}
-    void visit(Nef_polyhedron::Halfedge_const_handle he) {}
-    void visit(Nef_polyhedron::SHalfedge_const_handle she) {}
-    void visit(Nef_polyhedron::SHalfloop_const_handle shl) {}
-    void visit(Nef_polyhedron::SFace_const_handle sf) {}
+    /*
+    * convert each vertex to doubles exactly once, the later stages only use coordinates
+    */
+    void convert_coordinates() {
+        coordinates.resize(vertices.size());
+        for (std::size_t i = 0; i != vertices.size(); ++i) {
+            coordinates[i] = {
+                approximate(vertices[i].x()),
+                approximate(vertices[i].y()),
+                approximate(vertices[i].z()) };
+        }
+    }
 
-    void visit(Nef_polyhedron::Halffacet_const_handle hf) {
-        for (Nef_polyhedron::Halffacet_cycle_const_iterator it = hf->facet_cycles_begin(); it != hf->facet_cycles_end(); it++) {
+    /*
+    * signed volume enclosed by the faces, on the double coordinates
+    * each face is fanned into triangles, the tetrahedra are taken relative to the first vertex to keep the sums small
+    */
+    double compute_signed_volume() const {
+        if (coordinates.empty()) return 0;
+        const Approx_point& o = coordinates[0];
+        double volume = 0;
+        for (auto& face : faces) {
+            if (face.size() < 3) continue;
+            const Approx_point& p = coordinates[face[0]];
+            double ax = p[0] - o[0], ay = p[1] - o[1], az = p[2] - o[2];
+            for (std::size_t i = 1; i + 1 < face.size(); ++i) {
+                const Approx_point& q = coordinates[face[i]];
+                const Approx_point& r = coordinates[face[i + 1]];
+                double bx = q[0] - o[0], by = q[1] - o[1], bz = q[2] - o[2];
+                double cx = r[0] - o[0], cy = r[1] - o[1], cz = r[2] - o[2];
+                volume += ax * (by * cz - bz * cy) - ay * (bx * cz - bz * cx) + az * (bx * cy - by * cx);
+            }
+        }
+        return volume / 6;
+    }
+
+    /*
+    * index of a Nef vertex in vertices, the vertex is added the first time it is met
+    */
+    unsigned long vertex_index(Vertex_const_handle vh) {
+        auto it = vertex_indices.find(vh);
+        if (it != vertex_indices.end()) return it->second;
+
+        unsigned long index = (unsigned long)vertices.size();
+        vertex_indices.emplace(vh, index);
+        vertices.push_back(vh->point());
+        return index;
+    }
+
+    void visit(typename Nef_polyhedron::Vertex_const_handle v) {}
+    void visit(typename Nef_polyhedron::Halfedge_const_handle he) {}
+    void visit(typename Nef_polyhedron::SHalfedge_const_handle she) {}
+    void visit(typename Nef_polyhedron::SHalfloop_const_handle shl) {}
+    void visit(typename Nef_polyhedron::SFace_const_handle sf) {}
+
+    void visit(typename Nef_polyhedron::Halffacet_const_handle hf) {
+        for (typename Nef_polyhedron::Halffacet_cycle_const_iterator it = hf->facet_cycles_begin(); it != hf->facet_cycles_end(); it++) {
             
             //std::cout << it.is_shalfedge() << " " << it.is_shalfloop() << '\n';
-            Nef_polyhedron::SHalfedge_const_handle she = Nef_polyhedron::SHalfedge_const_handle(it);
+            typename Nef_polyhedron::SHalfedge_const_handle she = typename Nef_polyhedron::SHalfedge_const_handle(it);
             CGAL_assertion(she != 0);
-            Nef_polyhedron::SHalfedge_around_facet_const_circulator hc_start = she;
-            Nef_polyhedron::SHalfedge_around_facet_const_circulator hc_end = hc_start;
+            typename Nef_polyhedron::SHalfedge_around_facet_const_circulator hc_start = she;
+            typename Nef_polyhedron::SHalfedge_around_facet_const_circulator hc_end = hc_start;
             //std::cout << "hc_start = hc_end? " << (hc_start == hc_end) << '\n';
 
             faces.emplace_back();
-            int index = 0;
             CGAL_For_all(hc_start, hc_end) // each vertex of one halffacet
             {
-                Nef_polyhedron::SVertex_const_handle svert = hc_start->source();
-                Point vpoint = svert->center_vertex()->point();
-                //std::cout << "v: " << "(" << vpoint.x() << ", " << vpoint.y() << ", " << vpoint.z() << ")" << '\n';
-                vertices.push_back(vpoint);
-                faces.back().push_back(index++); 
+                typename Nef_polyhedron::SVertex_const_handle svert = hc_start->source();
+                faces.back().push_back(vertex_index(svert->center_vertex()));
             }
             //std::cout << '\n';
          
@@ -464,3 +896,415 @@ struct Shell_explorer {
     }
 };
 
+
+// simplify extracted shells: merge adjacent coplanar faces and remove vertices on straight edges
+template <class Policy>
+class SimplifyShell {
+private:
+    typedef typename Policy::Point Point;
+    typedef typename Policy::Kernel::Plane_3 Plane;
+    typedef Shell_explorer<Policy> Explorer;
+
+    static unsigned long find_root(std::vector<unsigned long>& parent, unsigned long i) {
+        while (parent[i] != i) {
+            parent[i] = parent[parent[i]];
+            i = parent[i];
+        }
+        return i;
+    }
+
+
+    /*
+    * supporting plane of a face, from its first three non-collinear vertices
+    * return: False - all vertices of the face are collinear
+    */
+    static bool face_plane(std::vector<Point>& vertices, std::vector<unsigned long>& face, Plane& plane) {
+        const Point& p = vertices[face[0]];
+        for (std::size_t i = 1; i + 1 < face.size(); ++i) {
+            const Point& q = vertices[face[i]];
+            const Point& r = vertices[face[i + 1]];
+            if (!CGAL::collinear(p, q, r)) {
+                plane = Plane(p, q, r);
+                return true;
+            }
+        }
+        return false;
+    }
+
+
+    /*
+    * merge a group of coplanar faces into one face by cancelling their shared edges
+    * return: False - the remaining edges do not form exactly one loop (ie the merged face would have holes)
+    */
+    static bool merge_faces(std::vector<std::vector<unsigned long>>& faces, std::vector<unsigned long>& group,
+        std::vector<unsigned long>& merged) {
+        std::set<std::pair<unsigned long, unsigned long>> edges;
+        for (auto& f : group) {
+            auto& face = faces[f];
+            for (std::size_t i = 0; i != face.size(); ++i) {
+                edges.insert(std::make_pair(face[i], face[(i + 1) % face.size()]));
+            }
+        }
+
+        std::map<unsigned long, unsigned long> next_vertex; // boundary edges of the merged face
+        for (auto& e : edges) {
+            if (edges.count(std::make_pair(e.second, e.first)) != 0) continue; // shared edge
+            if (next_vertex.count(e.first) != 0) return false; // vertex touched twice by the boundary
+            next_vertex[e.first] = e.second;
+        }
+        if (next_vertex.empty()) return false;
+
+        unsigned long start = next_vertex.begin()->first;
+        unsigned long current = start;
+        do {
+            merged.push_back(current);
+            auto it = next_vertex.find(current);
+            if (it == next_vertex.end() || merged.size() > next_vertex.size()) return false;
+            current = it->second;
+        } while (current != start);
+
+        return merged.size() == next_vertex.size();
+    }
+
+
+    /*
+    * merge adjacent faces lying on the same oriented plane
+    */
+    static void merge_coplanar_faces(Explorer& se) {
+        std::size_t num_faces = se.faces.size();
+        std::vector<Plane> planes(num_faces);
+        std::vector<bool> has_plane(num_faces, false);
+        for (std::size_t f = 0; f != num_faces; ++f) {
+            if (se.faces[f].size() >= 3) has_plane[f] = face_plane(se.vertices, se.faces[f], planes[f]);
+        }
+
+        // directed edge -> face
+        std::map<std::pair<unsigned long, unsigned long>, unsigned long> edge_face;
+        for (std::size_t f = 0; f != num_faces; ++f) {
+            auto& face = se.faces[f];
+            for (std::size_t i = 0; i != face.size(); ++i) {
+                edge_face[std::make_pair(face[i], face[(i + 1) % face.size()])] = (unsigned long)f;
+            }
+        }
+
+        // union adjacent coplanar faces
+        std::vector<unsigned long> parent(num_faces);
+        for (std::size_t f = 0; f != num_faces; ++f) parent[f] = (unsigned long)f;
+        for (auto& ef : edge_face) {
+            auto twin = edge_face.find(std::make_pair(ef.first.second, ef.first.first));
+            if (twin == edge_face.end()) continue;
+            unsigned long f = ef.second, g = twin->second;
+            if (f == g || !has_plane[f] || !has_plane[g] || planes[f] != planes[g]) continue;
+            parent[find_root(parent, f)] = find_root(parent, g);
+        }
+
+        std::map<unsigned long, std::vector<unsigned long>> groups; // root -> faces in the group
+        for (std::size_t f = 0; f != num_faces; ++f) {
+            groups[find_root(parent, (unsigned long)f)].push_back((unsigned long)f);
+        }
+
+        std::vector<std::vector<unsigned long>> faces;
+        for (auto& group : groups) {
+            std::vector<unsigned long> merged;
+            if (group.second.size() > 1 && merge_faces(se.faces, group.second, merged)) {
+                faces.push_back(merged);
+            }
+            else {
+                for (auto& f : group.second) faces.push_back(se.faces[f]);
+            }
+        }
+        se.faces = faces;
+    }
+
+
+    /*
+    * remove vertices lying on a straight edge: exactly two neighbours in the shell, collinear with both
+    * a vertex is removed from every face or from none, so the faces sharing an edge keep the same vertices on it
+    * (a vertex needed by a face that would be left with less than 3 vertices is kept everywhere)
+    */
+    static void remove_collinear_vertices(Explorer& se) {
+        std::vector<std::set<unsigned long>> neighbours(se.vertices.size());
+        for (auto& face : se.faces) {
+            for (std::size_t i = 0; i != face.size(); ++i) {
+                unsigned long u = face[i], v = face[(i + 1) % face.size()];
+                neighbours[u].insert(v);
+                neighbours[v].insert(u);
+            }
+        }
+
+        std::vector<bool> redundant(se.vertices.size(), false);
+        for (std::size_t v = 0; v != se.vertices.size(); ++v) {
+            if (neighbours[v].size() != 2) continue;
+            const Point& a = se.vertices[*neighbours[v].begin()];
+            const Point& b = se.vertices[*neighbours[v].rbegin()];
+            redundant[v] = CGAL::collinear(a, se.vertices[v], b);
+        }
+
+        // keeping a vertex only adds vertices to the other faces, one pass is enough
+        for (auto& face : se.faces) {
+            std::size_t num_kept = 0;
+            for (auto& index : face) {
+                if (!redundant[index]) ++num_kept;
+            }
+            if (num_kept >= 3) continue;
+            for (auto& index : face) redundant[index] = false;
+        }
+
+        for (auto& face : se.faces) {
+            std::vector<unsigned long> indices;
+            for (auto& index : face) {
+                if (!redundant[index]) indices.push_back(index);
+            }
+            face = indices;
+        }
+    }
+
+
+    /*
+    * drop vertices no longer referenced by any face, keep the order of the others
+    */
+    static void compact(Explorer& se) {
+        std::vector<long> new_index(se.vertices.size(), -1);
+        std::vector<Point> vertices;
+        for (auto& face : se.faces) {
+            for (auto& index : face) {
+                if (new_index[index] < 0) {
+                    new_index[index] = (long)vertices.size();
+                    vertices.push_back(se.vertices[index]);
+                }
+                index = (unsigned long)new_index[index];
+            }
+        }
+        se.vertices = vertices;
+        se.vertex_indices.clear(); // the Nef vertex -> index map is stale now
+    }
+public:
+
+    /*
+    * simplify one extracted shell in place
+    * se.vertices are unique, the explorer emits each Nef vertex once
+    */
+    static void simplify(Explorer& se) {
+        merge_coplanar_faces(se);
+        remove_collinear_vertices(se);
+        compact(se);
+    }
+};
+
+
+
+// extract the shells of the big nef
+// the traversal is read-only, so the shells are visited concurrently into preallocated explorers
+// NB: lazy exact numbers shared between shells need a thread safe CGAL, see Parallel_Enabled
+template <class Policy>
+class ExtractGeometries {
+private:
+    typedef typename Policy::Point Point;
+    typedef typename Policy::Nef_polyhedron Nef_polyhedron;
+    typedef typename Nef_polyhedron::SFace_const_handle SFace_const_handle;
+    typedef CGAL::Surface_mesh<Point> Mesh;
+    typedef typename Mesh::Vertex_index Mesh_vertex;
+    typedef typename Mesh::Face_index Mesh_face;
+    typedef typename Mesh::template Property_map<Mesh_face, std::size_t> Mesh_face_component;
+
+    /*
+    * the stages after collecting a shell: merge coplanar faces, remove vertices on straight edges, convert to doubles
+    */
+    static void finish_shell(Shell_explorer<Policy>& se) {
+        se.extracted_vertices = se.vertices.size();
+        se.extracted_faces = se.faces.size();
+        SimplifyShell<Policy>::simplify(se);
+        se.convert_coordinates();
+        se.signed_volume = se.compute_signed_volume();
+    }
+
+
+    /*
+    * label the shells of one volume of the visitor:
+    * shells of volume 0 (the unbounded outside) - exterior
+    * outer shell of an unmarked bounded volume - room, or void if it encloses less than Void_Volume
+    * everything else - solid, ie the shells of the marked volumes and the objects inside the rooms
+    * the outer shell of a bounded volume is its shell enclosing the largest volume
+    */
+    static void classify_volume(std::vector<Shell_explorer<Policy>>& shell_explorers, const std::vector<std::size_t>& shells) {
+        if (shells.empty()) return;
+        std::size_t outer_shell = shells[0];
+        for (auto& i : shells) {
+            if (std::abs(shell_explorers[i].signed_volume) > std::abs(shell_explorers[outer_shell].signed_volume)) outer_shell = i;
+        }
+
+        for (auto& i : shells) {
+            Shell_explorer<Policy>& se = shell_explorers[i];
+            se.outer = se.volume_index != 0 && i == outer_shell;
+            if (se.volume_mark) se.type = Shell_Type::SOLID;
+            else if (se.volume_index == 0) se.type = Shell_Type::EXTERIOR;
+            else if (!se.outer) se.type = Shell_Type::SOLID;
+            else if (std::abs(se.signed_volume) < Void_Volume) se.type = Shell_Type::VOID;
+            else se.type = Shell_Type::ROOM;
+        }
+    }
+
+
+    /*
+    * label a shell of the surface mesh, which only holds the boundary of the marked volumes oriented outwards:
+    * positive volume - the outer shell of a piece of the building, exterior
+    * negative volume - a cavity, room or void; its faces are reversed to point out of the cavity
+    * NB: without the volumes, a piece standing inside a room is taken as exterior as well
+    */
+    static void classify_component(Shell_explorer<Policy>& se) {
+        se.volume_mark = true;
+        if (se.signed_volume > 0) {
+            se.outer = true;
+            se.type = Shell_Type::EXTERIOR;
+            return;
+        }
+        for (auto& face : se.faces) std::reverse(face.begin(), face.end());
+        se.signed_volume = -se.signed_volume;
+        se.outer = false;
+        se.type = se.signed_volume < Void_Volume ? Shell_Type::VOID : Shell_Type::ROOM;
+    }
+
+
+    /*
+    * print the number of shells of each type
+    */
+    static void print_classification(std::vector<Shell_explorer<Policy>>& shell_explorers) {
+        std::size_t counts[4] = { 0, 0, 0, 0 };
+        for (auto& se : shell_explorers) ++counts[(int)se.type];
+        std::cout << "shells: " << counts[(int)Shell_Type::EXTERIOR] << " exterior, "
+            << counts[(int)Shell_Type::ROOM] << " room, "
+            << counts[(int)Shell_Type::VOID] << " void, "
+            << counts[(int)Shell_Type::SOLID] << " solid" << '\n';
+    }
+public:
+
+    /*
+    * extract with the method chosen by Extraction_Method
+    */
+    static void extract(Nef<Policy>& nef, std::vector<Shell_explorer<Policy>>& shell_explorers) {
+        Scoped_timer timer("extract");
+        if (Extraction_Method == Extraction_Mode::SURFACE_MESH) extract_surface_mesh(nef, shell_explorers);
+        else extract_visitor(nef, shell_explorers);
+
+        std::size_t num_vertices = 0, num_faces = 0, num_extracted_vertices = 0, num_extracted_faces = 0;
+        for (auto const& se : shell_explorers) {
+            num_vertices += se.vertices.size();
+            num_faces += se.faces.size();
+            num_extracted_vertices += se.extracted_vertices;
+            num_extracted_faces += se.extracted_faces;
+        }
+        std::cout << "shell simplification: " << num_extracted_faces << " -> " << num_faces << " faces, "
+            << num_extracted_vertices << " -> " << num_vertices << " vertices" << '\n';
+        Instrumentation::gauge("extract.shells", (double)shell_explorers.size());
+        Instrumentation::gauge("extract.vertices", (double)num_vertices);
+        Instrumentation::gauge("extract.faces", (double)num_faces);
+        Instrumentation::gauge("simplify.extracted_vertices", (double)num_extracted_vertices);
+        Instrumentation::gauge("simplify.extracted_faces", (double)num_extracted_faces);
+    }
+
+
+    /*
+    * step 1: collect the entry sface of every shell of every volume
+    * step 2: visit, simplify and convert the shells to doubles in parallel
+    * step 3: classify the shells, volume by volume
+    * shell_explorers[i] corresponds to the i-th entry
+    */
+    static void extract_visitor(Nef<Policy>& nef, std::vector<Shell_explorer<Policy>>& shell_explorers) {
+        std::vector<SFace_const_handle> shell_entries;
+        std::vector<std::size_t> shell_volumes;
+        std::vector<bool> volume_marks;
+
+        std::size_t volume_count = 0;
+        typename Nef_polyhedron::Volume_const_iterator current_volume;
+        CGAL_forall_volumes(current_volume, nef.big_nef) {
+            std::cout << "volume: " << volume_count << " ";
+            std::cout << "volume mark: " << current_volume->mark() << '\n';
+            volume_marks.push_back(current_volume->mark());
+            typename Nef_polyhedron::Shell_entry_const_iterator current_shell;
+            CGAL_forall_shells_of(current_shell, current_volume) {
+                shell_entries.push_back(SFace_const_handle(current_shell));
+                shell_volumes.push_back(volume_count);
+            }
+            ++volume_count;
+        }
+
+        std::size_t count = shell_entries.size();
+        shell_explorers.clear();
+        shell_explorers.resize(count);
+        std::vector<std::vector<std::size_t>> volume_shells(volume_count);
+        for (std::size_t i = 0; i != count; ++i) {
+            shell_explorers[i].volume_index = shell_volumes[i];
+            shell_explorers[i].volume_mark = volume_marks[shell_volumes[i]];
+            volume_shells[shell_volumes[i]].push_back(i);
+        }
+
+        const Nef_polyhedron& big_nef = nef.big_nef;
+        std::size_t num_threads = parallel_for(count, [&](std::size_t i) {
+            big_nef.visit_shell_objects(shell_entries[i], shell_explorers[i]);
+            finish_shell(shell_explorers[i]);
+        });
+        std::cout << "extract " << count << " shells using " << num_threads << " threads" << '\n';
+
+        for (auto const& shells : volume_shells) classify_volume(shell_explorers, shells);
+        print_classification(shell_explorers);
+    }
+
+
+    /*
+    * convert the big nef into one Surface_mesh, then split the mesh into shells by connected components
+    * the mesh holds the boundary of the marked volumes, each of their shells is one component,
+    * so the volume 0 copy of the exterior shell is not emitted and the shells are in component order
+    * faces with holes are triangulated by the conversion
+    * the shells are classified by the sign of their volume, see classify_component
+    */
+    static void extract_surface_mesh(Nef<Policy>& nef, std::vector<Shell_explorer<Policy>>& shell_explorers) {
+        Mesh mesh;
+        CGAL::convert_nef_polyhedron_to_polygon_mesh(nef.big_nef, mesh);
+
+        Mesh_face_component component = mesh.template add_property_map<Mesh_face, std::size_t>("f:component", 0).first;
+        std::size_t count = CGAL::Polygon_mesh_processing::connected_components(mesh, component);
+        std::cout << "surface mesh: " << mesh.number_of_vertices() << " vertices, "
+            << mesh.number_of_faces() << " faces, " << count << " components" << '\n';
+
+        shell_explorers.clear();
+        shell_explorers.resize(count);
+
+        // a mesh vertex lies in exactly one component, the conversion duplicates non-manifold vertices
+        typename Mesh::template Property_map<Mesh_vertex, long> shell_index =
+            mesh.template add_property_map<Mesh_vertex, long>("v:shell_index", -1).first;
+        for (Mesh_face f : mesh.faces()) {
+            Shell_explorer<Policy>& se = shell_explorers[component[f]];
+            se.faces.emplace_back();
+            for (Mesh_vertex v : CGAL::vertices_around_face(mesh.halfedge(f), mesh)) {
+                if (shell_index[v] < 0) {
+                    shell_index[v] = (long)se.vertices.size();
+                    se.vertices.push_back(mesh.point(v));
+                }
+                se.faces.back().push_back((unsigned long)shell_index[v]);
+            }
+        }
+
+        std::size_t num_threads = parallel_for(count, [&](std::size_t i) {
+            finish_shell(shell_explorers[i]);
+            classify_component(shell_explorers[i]);
+        });
+        std::cout << "extract " << count << " shells using " << num_threads << " threads" << '\n';
+        print_classification(shell_explorers);
+    }
+};
+
+
+// every kernel policy is instantiated once, in Kernels.cpp
+#define BIMCONVERT_KERNEL_INSTANTIATIONS(PREFIX, P) \
+    PREFIX template P::Point make_point<P>(double x, double y, double z); \
+    PREFIX template struct Nef<P>; \
+    PREFIX template class Build_Nef_Polyhedron<P>; \
+    PREFIX template class GapOffset<P>; \
+    PREFIX template class BigNef<P>; \
+    PREFIX template struct Shell_explorer<P>; \
+    PREFIX template class SimplifyShell<P>; \
+    PREFIX template class ExtractGeometries<P>;
+
+BIMCONVERT_KERNEL_INSTANTIATIONS(extern, Epeck_policy)
+BIMCONVERT_KERNEL_INSTANTIATIONS(extern, Cartesian_rational_policy)
+BIMCONVERT_KERNEL_INSTANTIATIONS(extern, Homogeneous_integer_policy)
@@ -0,0 +1,350 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <array>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+
+#include "json.hpp"
+#include "Polyhedra.hpp"
+#include "SyntheticOBJ.hpp"
+
+
+// regression check of a run: the city json is compared with a golden file (KIT.obj) or with the
+// volumes known from the generator (synthetic input), and the instrumented stages are held to budgets
+// run by BIMConvertToGeo --check obj|synthetic, the regression tests of ctest, one input per process
+const double Regression_Vertex_Tolerance = 0.002; // in model units, above the 1 mm grid of the city json transform
+const double Regression_Volume_Tolerance = 0.001; // relative
+const double Regression_Area_Tolerance = 0.001; // relative
+
+// time budget of the stages in seconds, see Scoped_timer; stages that did not run are not checked
+struct Stage_budget {
+	const char* stage;
+	double seconds;
+};
+const Stage_budget Regression_Time_Budgets[] = {
+	{ "load_obj", 5.0 },
+	{ "load_ifc", 5.0 },
+	{ "repeated_vertices_info", 30.0 },
+	{ "process_repeated_vertices", 30.0 },
+	{ "build_nef_polyhedra", 120.0 },
+	{ "build_nef_extrusions", 120.0 },
+	{ "test_big", 300.0 },
+	{ "regularize", 60.0 },
+	{ "extract", 60.0 },
+	{ "write_vertices_shells", 10.0 }
+};
+const std::size_t Regression_Memory_Budget = std::size_t(4) << 30; // peak resident set size of the process in bytes
+
+
+
+/*
+* semantic comparison of city json documents: what is compared is the geometry, not the text
+* - the vertices used by the solids: each vertex of the output lies on a golden vertex, up to Regression_Vertex_Tolerance
+*   (the transform is applied); golden vertices may be missing, the simplification removes vertices inside merged faces
+* - the surface areas of the solids of each city object type, up to Regression_Area_Tolerance
+* - the volumes of the solids of each city object type, up to Regression_Volume_Tolerance
+* ids, the order of the objects, the order of the vertices, the indices and the split of the surfaces into faces
+* are free to change
+*/
+class Regression {
+private:
+	// a solid of a city object, the vertices in model units
+	struct Solid {
+		std::string type; // BuildingPart, BuildingRoom ...
+		double area;
+		double volume;
+	};
+
+	struct Document {
+		std::vector<Approx_point> vertices; // used by the solids
+		std::vector<Solid> solids;          // sorted by type, then volume
+	};
+
+
+	/*
+	* volume of a solid from its boundaries [shell][surface][ring][vertex], each ring as a fan
+	* the inner shells and rings are oriented against the outer ones and subtract themselves
+	*/
+	static double volume(const nlohmann::json& boundaries, const std::vector<Approx_point>& vertices) {
+		double six_volume = 0;
+		for (auto const& shell : boundaries) {
+			for (auto const& surface : shell) {
+				for (auto const& ring : surface) {
+					for (std::size_t i = 1; i + 1 < ring.size(); ++i) {
+						const Approx_point& a = vertices[ring[0].get<std::size_t>()];
+						const Approx_point& b = vertices[ring[i].get<std::size_t>()];
+						const Approx_point& c = vertices[ring[i + 1].get<std::size_t>()];
+						six_volume += a[0] * (b[1] * c[2] - b[2] * c[1]) - a[1] * (b[0] * c[2] - b[2] * c[0]) + a[2] * (b[0] * c[1] - b[1] * c[0]);
+					}
+				}
+			}
+		}
+		return std::abs(six_volume) / 6;
+	}
+
+
+	/*
+	* surface area of a solid from its boundaries, each surface from the sum of the Newell normals of its rings
+	* (the inner rings are oriented against the outer one and subtract themselves)
+	*/
+	static double area(const nlohmann::json& boundaries, const std::vector<Approx_point>& vertices) {
+		double two_area = 0;
+		for (auto const& shell : boundaries) {
+			for (auto const& surface : shell) {
+				Approx_point normal = { 0.0, 0.0, 0.0 };
+				for (auto const& ring : surface) {
+					for (std::size_t i = 0; i != ring.size(); ++i) {
+						const Approx_point& a = vertices[ring[i].get<std::size_t>()];
+						const Approx_point& b = vertices[ring[(i + 1) % ring.size()].get<std::size_t>()];
+						normal[0] += (a[1] - b[1]) * (a[2] + b[2]);
+						normal[1] += (a[2] - b[2]) * (a[0] + b[0]);
+						normal[2] += (a[0] - b[0]) * (a[1] + b[1]);
+					}
+				}
+				two_area += std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+			}
+		}
+		return two_area / 2;
+	}
+
+
+	/*
+	* the solids and their vertices
+	* return: False - the document is not city json
+	*/
+	static bool read_document(const nlohmann::json& city_json, Document& document) {
+		if (!city_json.is_object() || !city_json.contains("CityObjects") || !city_json.contains("vertices")) return false;
+
+		Approx_point scale = { 1.0, 1.0, 1.0 }, translate = { 0.0, 0.0, 0.0 };
+		if (city_json.contains("transform")) {
+			for (int c = 0; c != 3; ++c) {
+				scale[c] = city_json["transform"]["scale"][c].get<double>();
+				translate[c] = city_json["transform"]["translate"][c].get<double>();
+			}
+		}
+		std::vector<Approx_point> vertices;
+		for (auto const& v : city_json["vertices"]) {
+			vertices.push_back({ v[0].get<double>() * scale[0] + translate[0], v[1].get<double>() * scale[1] + translate[1],
+				v[2].get<double>() * scale[2] + translate[2] });
+		}
+
+		std::vector<bool> used(vertices.size(), false);
+		for (auto const& object : city_json["CityObjects"]) {
+			if (!object.contains("geometry")) continue;
+			for (auto const& geometry : object["geometry"]) {
+				if (geometry.value("type", "") != "Solid") continue; // ie GeometryInstance
+				const nlohmann::json& boundaries = geometry["boundaries"];
+				Solid solid = { object.value("type", ""), area(boundaries, vertices), volume(boundaries, vertices) };
+				for (auto const& shell : boundaries) {
+					for (auto const& surface : shell) {
+						for (auto const& ring : surface) {
+							for (auto const& index : ring) used[index.get<std::size_t>()] = true;
+						}
+					}
+				}
+				document.solids.push_back(solid);
+			}
+		}
+		for (std::size_t i = 0; i != vertices.size(); ++i) {
+			if (used[i]) document.vertices.push_back(vertices[i]);
+		}
+		std::sort(document.solids.begin(), document.solids.end(), [](const Solid& a, const Solid& b) {
+			return a.type != b.type ? a.type < b.type : a.volume < b.volume;
+		});
+		return true;
+	}
+
+
+	/*
+	* number of vertices of a without a vertex of b within tolerance (in each coordinate)
+	* b is hashed on a grid of cells of size tolerance, a vertex is looked up in its cell and the neighbours
+	*/
+	static std::size_t unmatched_vertices(const std::vector<Approx_point>& a, const std::vector<Approx_point>& b, double tolerance) {
+		struct Cell_hash {
+			std::size_t operator()(const std::array<long long, 3>& cell) const {
+				return std::hash<long long>()(cell[0] * 73856093LL ^ cell[1] * 19349663LL ^ cell[2] * 83492791LL);
+			}
+		};
+		std::unordered_map<std::array<long long, 3>, std::vector<std::size_t>, Cell_hash> grid;
+		auto cell_of = [&](const Approx_point& p) {
+			return std::array<long long, 3>{ (long long)std::floor(p[0] / tolerance), (long long)std::floor(p[1] / tolerance),
+				(long long)std::floor(p[2] / tolerance) };
+		};
+		for (std::size_t i = 0; i != b.size(); ++i) grid[cell_of(b[i])].push_back(i);
+
+		std::size_t unmatched = 0;
+		for (auto const& p : a) {
+			std::array<long long, 3> cell = cell_of(p);
+			bool found = false;
+			for (long long dx = -1; dx <= 1 && !found; ++dx) {
+				for (long long dy = -1; dy <= 1 && !found; ++dy) {
+					for (long long dz = -1; dz <= 1 && !found; ++dz) {
+						auto it = grid.find({ cell[0] + dx, cell[1] + dy, cell[2] + dz });
+						if (it == grid.end()) continue;
+						for (auto const& i : it->second) {
+							if (std::abs(b[i][0] - p[0]) <= tolerance && std::abs(b[i][1] - p[1]) <= tolerance &&
+								std::abs(b[i][2] - p[2]) <= tolerance) {
+								found = true;
+								break;
+							}
+						}
+					}
+				}
+			}
+			if (!found) ++unmatched;
+		}
+		return unmatched;
+	}
+
+
+	static bool same_volume(double a, double b) {
+		return std::abs(a - b) <= Regression_Volume_Tolerance * std::max({ std::abs(a), std::abs(b), 1e-9 });
+	}
+
+
+	static bool same_area(double a, double b) {
+		return std::abs(a - b) <= Regression_Area_Tolerance * std::max({ std::abs(a), std::abs(b), 1e-9 });
+	}
+
+
+	static void report(const std::string& check, bool passed, const std::string& detail) {
+		std::cout << "regression: " << check << (passed ? " ok" : " FAILED") << (detail.empty() ? "" : " -- " + detail) << '\n';
+	}
+public:
+
+	/*
+	* read OUTPUT_PATH + fname
+	* return: null if the file can not be read or parsed
+	*/
+	static nlohmann::json read_city_json(const std::string& fname) {
+		std::string filename = OUTPUT_PATH + fname;
+		std::ifstream in(filename);
+		if (!in.is_open()) {
+			std::cout << "warning: can not open " << filename << '\n';
+			return nlohmann::json();
+		}
+		nlohmann::json city_json = nlohmann::json::parse(in, nullptr, false);
+		if (city_json.is_discarded()) {
+			std::cout << "warning: can not parse " << filename << '\n';
+			return nlohmann::json();
+		}
+		return city_json;
+	}
+
+
+	/*
+	* compare the output with the golden document
+	* return: True - the same geometry, up to the tolerances
+	*/
+	static bool check_golden(const nlohmann::json& output, const nlohmann::json& golden) {
+		Document out_doc, golden_doc;
+		if (!read_document(output, out_doc) || !read_document(golden, golden_doc)) {
+			report("golden", false, "the output or the golden file is not city json");
+			return false;
+		}
+		bool passed = true;
+
+		std::size_t missing = unmatched_vertices(golden_doc.vertices, out_doc.vertices, Regression_Vertex_Tolerance);
+		std::size_t extra = unmatched_vertices(out_doc.vertices, golden_doc.vertices, Regression_Vertex_Tolerance);
+		report("vertices", extra == 0, std::to_string(out_doc.vertices.size()) + " vertices, " +
+			std::to_string(extra) + " not in the golden file, " + std::to_string(missing) + " golden vertices not used");
+		passed = passed && extra == 0;
+
+		if (out_doc.solids.size() != golden_doc.solids.size()) {
+			report("solids", false, std::to_string(out_doc.solids.size()) + " solids, golden " + std::to_string(golden_doc.solids.size()));
+			return false;
+		}
+		bool solids_passed = true;
+		for (std::size_t i = 0; i != out_doc.solids.size(); ++i) {
+			const Solid& a = out_doc.solids[i];
+			const Solid& b = golden_doc.solids[i];
+			bool same = a.type == b.type && same_area(a.area, b.area) && same_volume(a.volume, b.volume);
+			if (!same) {
+				report("solid", false, a.type + " with area " + std::to_string(a.area) + " and volume " + std::to_string(a.volume) +
+					", golden " + b.type + " with area " + std::to_string(b.area) + " and volume " + std::to_string(b.volume));
+			}
+			solids_passed = solids_passed && same;
+		}
+		report("solids", solids_passed, std::to_string(out_doc.solids.size()) + " solids");
+		return passed && solids_passed;
+	}
+
+
+	/*
+	* compare the output of a synthetic building with its known rooms and envelope
+	* each window leaves a recess of depth (wall - window) / 2 on each side of its wall,
+	* which belongs to the room inside and is missing from the envelope outside
+	*/
+	static bool check_synthetic(const nlohmann::json& output, const Synthetic_building& b) {
+		Document doc;
+		if (!read_document(output, doc)) {
+			report("synthetic", false, "the output is not city json");
+			return false;
+		}
+		double t = b.wall_thickness;
+		double recess = b.windows * b.window_width * b.window_height * (t - b.window_depth) / 2;
+		double room = b.room_width * b.room_depth * b.storey_height + 2 * recess;
+		double envelope = (b.rooms * b.room_width + (b.rooms + 1) * t) * (b.room_depth + 2 * t) *
+			(b.storeys * (b.slab_thickness + b.storey_height) + b.slab_thickness) - b.storeys * b.rooms * 2 * recess;
+
+		std::size_t num_rooms = 0, num_parts = 0;
+		bool passed = true;
+		for (auto const& solid : doc.solids) {
+			if (solid.type == "BuildingRoom") {
+				++num_rooms;
+				if (!same_volume(solid.volume, room)) {
+					report("room", false, "volume " + std::to_string(solid.volume) + ", expected " + std::to_string(room));
+					passed = false;
+				}
+			}
+			else if (solid.type == "BuildingPart") {
+				++num_parts;
+				if (!same_volume(solid.volume, envelope)) {
+					report("envelope", false, "volume " + std::to_string(solid.volume) + ", expected " + std::to_string(envelope));
+					passed = false;
+				}
+			}
+		}
+		bool counts = num_rooms == (std::size_t)(b.storeys * b.rooms) && num_parts == 1;
+		report("synthetic", passed && counts, std::to_string(num_parts) + " envelope, " + std::to_string(num_rooms) +
+			" rooms, expected 1 and " + std::to_string(b.storeys * b.rooms));
+		return passed && counts;
+	}
+
+
+	/*
+	* hold the stages recorded by the instrumentation to Regression_Time_Budgets and the process to Regression_Memory_Budget
+	* the peak rss is never reset, call this once per process after its single run
+	* the check fails when nothing is measured: with Instrumentation_Enabled off, or without a peak rss on this platform
+	*/
+	static bool check_budgets() {
+		if (!Instrumentation_Enabled) {
+			report("budgets", false, "not measured, Instrumentation_Enabled is off");
+			return false;
+		}
+		bool passed = true;
+		for (auto const& budget : Regression_Time_Budgets) {
+			double seconds = Instrumentation::stage_seconds(budget.stage);
+			if (seconds > budget.seconds) {
+				report(std::string("time of ") + budget.stage, false, std::to_string(seconds) + " s, budget " + std::to_string(budget.seconds) + " s");
+				passed = false;
+			}
+		}
+		std::size_t peak = Instrumentation::peak_rss();
+		if (peak == 0) {
+			report("memory", false, "not measured, no peak rss on this platform");
+			passed = false;
+		}
+		else if (peak > Regression_Memory_Budget) {
+			report("memory", false, std::to_string(peak >> 20) + " MB, budget " + std::to_string(Regression_Memory_Budget >> 20) + " MB");
+			passed = false;
+		}
+		report("budgets", passed, "peak rss " + std::to_string(peak >> 20) + " MB");
+		return passed;
+	}
+};
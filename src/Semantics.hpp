@@ -0,0 +1,132 @@
+#pragma once
+
+#include "Polyhedra.hpp"
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+
+// semantic surfaces of the exterior shell, the values index the "surfaces" array of the semantics
+enum Semantic_Surface {
+	SEMANTIC_NONE = -1, // written as null
+	SEMANTIC_GROUND = 0,
+	SEMANTIC_WALL = 1,
+	SEMANTIC_ROOF = 2
+};
+
+// thresholds of the classification, on the unit normal pointing out of the building
+const double Semantic_Wall_Tolerance = 0.1;  // |nz| below this: wall, ie within about 6 degrees of vertical
+const double Semantic_Ground_Height = 0.2;   // downward faces this close above the lowest point: ground, in model units
+
+
+
+/*
+* classify the faces of an exterior shell from their Newell normals and centroids
+* the corners of all faces are gathered into flat coordinate arrays (structure of arrays)
+* so that the Newell terms run as straight loops the compiler can vectorize (in an optimized build)
+*/
+class SemanticSurfaces {
+private:
+	// corners of all faces, face f owns corners [offsets[f], offsets[f + 1])
+	struct Corners {
+		std::vector<std::size_t> offsets;
+		std::vector<double> x, y, z;
+	};
+
+
+	/*
+	* gather the coordinates of the corners, the only loop with indirect access
+	*/
+	static void gather(const std::vector<Approx_point>& vertices, const std::vector<std::vector<unsigned long>>& faces, Corners& c) {
+		std::size_t num_corners = 0;
+		c.offsets.resize(faces.size() + 1);
+		for (std::size_t f = 0; f != faces.size(); ++f) {
+			c.offsets[f] = num_corners;
+			num_corners += faces[f].size();
+		}
+		c.offsets[faces.size()] = num_corners;
+
+		c.x.resize(num_corners); c.y.resize(num_corners); c.z.resize(num_corners);
+		std::size_t k = 0;
+		for (auto const& face : faces) {
+			for (auto const& index : face) {
+				const Approx_point& p = vertices[index];
+				c.x[k] = p[0]; c.y[k] = p[1]; c.z[k] = p[2];
+				++k;
+			}
+		}
+	}
+public:
+
+	/*
+	* semantic surface of each face of an exterior shell
+	* the normals are flipped if the shell encloses a negative volume, ie if its faces point inwards
+	* downward faces near the bottom of the shell - ground, near vertical faces - wall, upward faces - roof,
+	* other faces (eg the underside of an overhang) - none
+	*/
+	static std::vector<Semantic_Surface> classify(const std::vector<Approx_point>& vertices, const std::vector<std::vector<unsigned long>>& faces) {
+		std::size_t num_faces = faces.size();
+		std::vector<Semantic_Surface> semantics(num_faces, SEMANTIC_NONE);
+		if (num_faces == 0) return semantics;
+
+		Corners c;
+		gather(vertices, faces, c);
+		std::size_t num_corners = c.x.size();
+
+		// Newell terms of each corner with the next corner in the arrays,
+		// then the last corner of each face is redone with the first corner of the face
+		std::vector<double> tx(num_corners), ty(num_corners), tz(num_corners);
+		const double* x = c.x.data(); const double* y = c.y.data(); const double* z = c.z.data();
+		double* px = tx.data(); double* py = ty.data(); double* pz = tz.data();
+		for (std::size_t k = 0; k + 1 < num_corners; ++k) {
+			px[k] = (y[k] - y[k + 1]) * (z[k] + z[k + 1]);
+			py[k] = (z[k] - z[k + 1]) * (x[k] + x[k + 1]);
+			pz[k] = (x[k] - x[k + 1]) * (y[k] + y[k + 1]);
+		}
+		for (std::size_t f = 0; f != num_faces; ++f) {
+			if (c.offsets[f] == c.offsets[f + 1]) continue;
+			std::size_t k = c.offsets[f + 1] - 1, first = c.offsets[f];
+			px[k] = (y[k] - y[first]) * (z[k] + z[first]);
+			py[k] = (z[k] - z[first]) * (x[k] + x[first]);
+			pz[k] = (x[k] - x[first]) * (y[k] + y[first]);
+		}
+
+		// normal and centroid of each face, the normal is twice the area vector
+		std::vector<double> nx(num_faces), ny(num_faces), nz(num_faces);
+		std::vector<double> cx(num_faces), cy(num_faces), cz(num_faces);
+		for (std::size_t f = 0; f != num_faces; ++f) {
+			double sx = 0, sy = 0, sz = 0, mx = 0, my = 0, mz = 0;
+			for (std::size_t k = c.offsets[f]; k < c.offsets[f + 1]; ++k) {
+				sx += px[k]; sy += py[k]; sz += pz[k];
+				mx += x[k]; my += y[k]; mz += z[k];
+			}
+			double n = (double)std::max<std::size_t>(1, c.offsets[f + 1] - c.offsets[f]);
+			nx[f] = sx; ny[f] = sy; nz[f] = sz;
+			cx[f] = mx / n; cy[f] = my / n; cz[f] = mz / n;
+		}
+
+		// orientation of the shell: six times the enclosed volume, summed over the faces
+		double volume = 0;
+		double z_min = std::numeric_limits<double>::max();
+		for (std::size_t f = 0; f < num_faces; ++f) {
+			volume += nx[f] * cx[f] + ny[f] * cy[f] + nz[f] * cz[f];
+		}
+		for (std::size_t k = 0; k < num_corners; ++k) {
+			z_min = std::min(z_min, z[k]);
+		}
+		double orientation = volume < 0 ? -1.0 : 1.0;
+
+		for (std::size_t f = 0; f < num_faces; ++f) {
+			double length = std::sqrt(nx[f] * nx[f] + ny[f] * ny[f] + nz[f] * nz[f]);
+			if (length == 0) continue; // degenerated face
+			double up = orientation * nz[f] / length;
+
+			if (std::abs(up) < Semantic_Wall_Tolerance) semantics[f] = SEMANTIC_WALL;
+			else if (up > 0) semantics[f] = SEMANTIC_ROOF;
+			else if (cz[f] - z_min <= Semantic_Ground_Height) semantics[f] = SEMANTIC_GROUND;
+		}
+		return semantics;
+	}
+};
@@ -0,0 +1,334 @@
+#pragma once
+
+#include "LoadOBJ.hpp"
+
+#include <vector>
+#include <array>
+#include <map>
+#include <random>
+#include <algorithm>
+#include <cstdio>
+#include <iomanip>
+
+
+// defects written into some products, to exercise the repair paths (convex hull fallback, welding)
+enum class Synthetic_Defect {
+	MISSING_FACE,   // the last face is left out, the shell is open
+	DUPLICATE_FACE, // the first face is written twice, its edges have three faces
+	EDGE_CONTACT    // a box touching the product along one vertical edge only, in the same shell
+};
+
+
+
+// parameters of a synthetic building: storeys of rooms in a row along x, every element one product
+// per storey a floor slab, four exterior walls, the walls between the rooms and the windows of the long walls,
+// the roof slab on top; the walls and windows leave no gap, so the union has one closed room per room
+struct Synthetic_building {
+	int storeys;
+	int rooms;              // per storey
+	double room_width;      // along x, between the walls
+	double room_depth;      // along y, between the walls
+	double storey_height;   // between the slabs
+	double wall_thickness;
+	double slab_thickness;
+	int windows;            // per room, in each of its two exterior walls
+	double window_width;
+	double window_height;
+	double window_sill;     // above the floor slab
+	double window_depth;    // the window fills its opening across the wall, centred in the wall
+	double jitter;          // each written vertex moves by up to this much per coordinate, near-duplicates of the shared corners
+	int defects;            // products with a defect, see Synthetic_Defect
+	unsigned int seed;      // of the jitter and of the choice of the defective products
+
+	Synthetic_building(int storeys_ = 2, int rooms_ = 4) :
+		storeys(storeys_), rooms(rooms_),
+		room_width(4.0), room_depth(5.0), storey_height(2.7),
+		wall_thickness(0.3), slab_thickness(0.3),
+		windows(1), window_width(1.2), window_height(1.2), window_sill(0.9), window_depth(0.1),
+		jitter(0.0), defects(0), seed(1)
+	{}
+};
+
+
+
+/*
+* write a synthetic building as IfcConvert writes an obj file: per product a group "product-<guid>-body" and a shell "s 1",
+* its vertices and normals, a material and triangles "f a//a b//b c//c"
+* as in IfcConvert output a vertex is repeated for each normal it has within a product, and again in each product it belongs to
+*/
+class SyntheticOBJ {
+private:
+	// a closed polygon mesh, faces are counterclockwise seen from outside
+	struct Mesh {
+		std::vector<Vector3d> points;
+		std::vector<std::vector<std::size_t>> faces;
+	};
+
+
+	static void add_box(Mesh& mesh, double x0, double y0, double z0, double x1, double y1, double z1) {
+		std::size_t base = mesh.points.size();
+		for (int k = 0; k != 2; ++k) {
+			double z = k ? z1 : z0;
+			mesh.points.emplace_back(x0, y0, z);
+			mesh.points.emplace_back(x1, y0, z);
+			mesh.points.emplace_back(x1, y1, z);
+			mesh.points.emplace_back(x0, y1, z);
+		}
+		static const std::size_t quads[6][4] = {
+			{ 0, 3, 2, 1 }, { 4, 5, 6, 7 }, { 0, 1, 5, 4 }, { 1, 2, 6, 5 }, { 2, 3, 7, 6 }, { 3, 0, 4, 7 } };
+		for (auto const& q : quads) mesh.faces.push_back({ base + q[0], base + q[1], base + q[2], base + q[3] });
+	}
+
+
+	/*
+	* wall of length along u, thickness along v and with rectangular openings [u0, u1] x [sill, head] through it
+	* the faces of each side follow the grid of the opening edges, so that every edge is shared by two faces
+	* to_world: maps (u, v, z) to model coordinates, a rotation around z and a translation
+	*/
+	template <class Map>
+	static Mesh wall(double length, double thickness, double z0, double z1,
+		const std::vector<std::pair<double, double>>& openings, double sill, double head, Map to_world) {
+		std::vector<double> us = { 0.0, length };
+		std::vector<double> zs = { z0, z1 };
+		for (auto const& opening : openings) {
+			us.push_back(opening.first);
+			us.push_back(opening.second);
+		}
+		if (!openings.empty()) {
+			zs.push_back(sill);
+			zs.push_back(head);
+		}
+		std::sort(us.begin(), us.end());
+		std::sort(zs.begin(), zs.end());
+		std::size_t nu = us.size(), nz = zs.size();
+
+		Mesh mesh;
+		for (int side = 0; side != 2; ++side) {
+			for (std::size_t k = 0; k != nz; ++k) {
+				for (std::size_t i = 0; i != nu; ++i) mesh.points.push_back(to_world(us[i], side ? thickness : 0.0, zs[k]));
+			}
+		}
+		auto n = [&](std::size_t i, std::size_t k, int side) { return (std::size_t)side * nu * nz + k * nu + i; };
+		auto is_opening = [&](std::size_t i, std::size_t k) {
+			for (auto const& opening : openings) {
+				if (opening.first == us[i] && opening.second == us[i + 1] && zs[k] == sill && zs[k + 1] == head) return true;
+			}
+			return false;
+		};
+
+		for (std::size_t k = 0; k + 1 < nz; ++k) {
+			for (std::size_t i = 0; i + 1 < nu; ++i) {
+				if (is_opening(i, k)) { // reveals: sill, head and the two jambs
+					mesh.faces.push_back({ n(i, k, 0), n(i + 1, k, 0), n(i + 1, k, 1), n(i, k, 1) });
+					mesh.faces.push_back({ n(i, k + 1, 0), n(i, k + 1, 1), n(i + 1, k + 1, 1), n(i + 1, k + 1, 0) });
+					mesh.faces.push_back({ n(i, k, 0), n(i, k, 1), n(i, k + 1, 1), n(i, k + 1, 0) });
+					mesh.faces.push_back({ n(i + 1, k, 0), n(i + 1, k + 1, 0), n(i + 1, k + 1, 1), n(i + 1, k, 1) });
+					continue;
+				}
+				mesh.faces.push_back({ n(i, k, 0), n(i + 1, k, 0), n(i + 1, k + 1, 0), n(i, k + 1, 0) }); // v = 0
+				mesh.faces.push_back({ n(i, k, 1), n(i, k + 1, 1), n(i + 1, k + 1, 1), n(i + 1, k, 1) }); // v = thickness
+			}
+		}
+		for (std::size_t i = 0; i + 1 < nu; ++i) {
+			mesh.faces.push_back({ n(i, 0, 0), n(i, 0, 1), n(i + 1, 0, 1), n(i + 1, 0, 0) }); // bottom
+			mesh.faces.push_back({ n(i, nz - 1, 0), n(i + 1, nz - 1, 0), n(i + 1, nz - 1, 1), n(i, nz - 1, 1) }); // top
+		}
+		for (std::size_t k = 0; k + 1 < nz; ++k) {
+			mesh.faces.push_back({ n(0, k, 0), n(0, k + 1, 0), n(0, k + 1, 1), n(0, k, 1) }); // u = 0
+			mesh.faces.push_back({ n(nu - 1, k, 0), n(nu - 1, k, 1), n(nu - 1, k + 1, 1), n(nu - 1, k + 1, 0) }); // u = length
+		}
+		return mesh;
+	}
+
+
+	static void add_defect(Mesh& mesh, Synthetic_Defect defect) {
+		if (mesh.faces.empty()) return;
+		if (defect == Synthetic_Defect::MISSING_FACE) {
+			mesh.faces.pop_back();
+		}
+		else if (defect == Synthetic_Defect::DUPLICATE_FACE) {
+			mesh.faces.push_back(mesh.faces.front());
+		}
+		else {
+			Vector3d max_corner = mesh.points.front();
+			double z_min = max_corner.z;
+			for (auto const& p : mesh.points) {
+				max_corner = Vector3d(std::max(max_corner.x, p.x), std::max(max_corner.y, p.y), std::max(max_corner.z, p.z));
+				z_min = std::min(z_min, p.z);
+			}
+			add_box(mesh, max_corner.x, max_corner.y, z_min, max_corner.x + 0.5, max_corner.y + 0.5, max_corner.z);
+		}
+	}
+
+
+	/*
+	* unit Newell normal of a face, exact for the axis aligned faces of the generator
+	*/
+	static Vector3d normal(const Mesh& mesh, const std::vector<std::size_t>& face) {
+		double nx = 0, ny = 0, nz = 0;
+		for (std::size_t i = 0; i != face.size(); ++i) {
+			const Vector3d& a = mesh.points[face[i]];
+			const Vector3d& b = mesh.points[face[(i + 1) % face.size()]];
+			nx += (a.y - b.y) * (a.z + b.z);
+			ny += (a.z - b.z) * (a.x + b.x);
+			nz += (a.x - b.x) * (a.y + b.y);
+		}
+		double length = std::sqrt(nx * nx + ny * ny + nz * nz);
+		if (length == 0) return Vector3d();
+		return Vector3d(nx / length, ny / length, nz / length);
+	}
+
+
+	/*
+	* write one product, base: the number of vertices written before it
+	* return: the number of vertices written for it
+	*/
+	static std::size_t write_product(std::ofstream& out, std::size_t product, const Mesh& mesh, std::size_t base,
+		double jitter, std::mt19937& random) {
+		// (point, normal) -> obj vertex, numbered from 1 within the product
+		std::map<std::pair<std::size_t, std::size_t>, std::size_t> vertex_index;
+		std::vector<std::pair<std::size_t, std::size_t>> vertices;
+		std::vector<Vector3d> normals;
+		std::map<std::array<long long, 3>, std::size_t> normal_index;
+		std::vector<std::vector<std::size_t>> faces;
+
+		for (auto const& face : mesh.faces) {
+			Vector3d n = normal(mesh, face);
+			std::array<long long, 3> key = { std::llround(n.x * 1e6), std::llround(n.y * 1e6), std::llround(n.z * 1e6) };
+			auto inserted = normal_index.emplace(key, normals.size());
+			if (inserted.second) normals.push_back(n);
+
+			faces.emplace_back();
+			for (auto const& p : face) {
+				auto v = vertex_index.emplace(std::make_pair(p, inserted.first->second), vertices.size() + 1);
+				if (v.second) vertices.push_back(v.first->first);
+				faces.back().push_back(v.first->second);
+			}
+		}
+
+		char guid[40];
+		std::snprintf(guid, sizeof(guid), "%08zx-0000-4000-8000-%012zx", product, product * 2654435761u % 0xFFFFFFFFFFFFu);
+		out << "g product-" << guid << "-body" << '\n';
+		out << "s 1" << '\n';
+		std::uniform_real_distribution<double> offset(-jitter, jitter);
+		for (auto const& v : vertices) {
+			const Vector3d& p = mesh.points[v.first];
+			if (jitter > 0) out << "v " << p.x + offset(random) << " " << p.y + offset(random) << " " << p.z + offset(random) << '\n';
+			else out << "v " << p.x << " " << p.y << " " << p.z << '\n';
+		}
+		for (auto const& v : vertices) {
+			const Vector3d& n = normals[v.second];
+			out << "vn " << n.x << " " << n.y << " " << n.z << '\n';
+		}
+		out << "usemtl surface-style-" << product % 8 << "-synthetic" << '\n';
+
+		// the faces are convex, triangulated as fans
+		for (auto const& face : faces) {
+			for (std::size_t i = 1; i + 1 < face.size(); ++i) {
+				std::size_t a = base + face[0], b = base + face[i], c = base + face[i + 1];
+				out << "f " << a << "//" << a << " " << b << "//" << b << " " << c << "//" << c << '\n';
+			}
+		}
+		return vertices.size();
+	}
+
+
+	/*
+	* the products of building b: slabs, walls and windows, bottom up
+	*/
+	static std::vector<Mesh> products(const Synthetic_building& b) {
+		std::vector<Mesh> meshes;
+		double t = b.wall_thickness;
+		double length = b.rooms * b.room_width + (b.rooms + 1) * t; // along x
+		double depth = b.room_depth + 2 * t; // along y
+		double storey = b.slab_thickness + b.storey_height;
+
+		// openings of the long walls, along x
+		std::vector<std::pair<double, double>> openings;
+		for (int r = 0; r != b.rooms; ++r) {
+			double room_start = t + r * (b.room_width + t);
+			double spacing = b.room_width / b.windows;
+			for (int w = 0; w != b.windows; ++w) {
+				double centre = room_start + (w + 0.5) * spacing;
+				openings.emplace_back(centre - b.window_width / 2, centre + b.window_width / 2);
+			}
+		}
+
+		for (int s = 0; s != b.storeys; ++s) {
+			double z0 = s * storey;
+			double floor = z0 + b.slab_thickness, ceiling = floor + b.storey_height;
+			double sill = floor + b.window_sill, head = sill + b.window_height;
+
+			meshes.emplace_back();
+			add_box(meshes.back(), 0, 0, z0, length, depth, floor);
+
+			meshes.push_back(wall(length, t, floor, ceiling, openings, sill, head,
+				[&](double u, double v, double z) { return Vector3d(u, v, z); }));
+			meshes.push_back(wall(length, t, floor, ceiling, openings, sill, head,
+				[&](double u, double v, double z) { return Vector3d(u, depth - t + v, z); }));
+
+			// walls across, at each end and between the rooms
+			for (int r = 0; r <= b.rooms; ++r) {
+				double x = r * (b.room_width + t);
+				meshes.push_back(wall(b.room_depth, t, floor, ceiling, {}, sill, head,
+					[&](double u, double v, double z) { return Vector3d(x + t - v, t + u, z); }));
+			}
+
+			for (auto const& opening : openings) {
+				for (double y : { t / 2, depth - t / 2 }) {
+					meshes.emplace_back();
+					add_box(meshes.back(), opening.first, y - b.window_depth / 2, sill, opening.second, y + b.window_depth / 2, head);
+				}
+			}
+		}
+
+		meshes.emplace_back();
+		add_box(meshes.back(), 0, 0, b.storeys * storey, length, depth, b.storeys * storey + b.slab_thickness); // roof
+		return meshes;
+	}
+public:
+
+	/*
+	* write building b to INPUT_PATH + fname, to be read by LoadOBJ::load_obj
+	* return: the number of products (shells) written, 0 if the file can not be written or b is not a valid building
+	*/
+	static std::size_t write(const std::string& fname, const Synthetic_building& b) {
+		if (b.storeys < 1 || b.rooms < 1 || b.windows < 0 || b.window_depth >= b.wall_thickness ||
+			b.windows * b.window_width >= b.room_width || b.window_sill <= 0 || b.window_sill + b.window_height >= b.storey_height) {
+			std::cout << "warning: the synthetic building does not fit, please check its parameters" << '\n';
+			return 0;
+		}
+
+		std::string path = INPUT_PATH;
+		std::string filename = path + fname;
+		std::ofstream out(filename);
+		if (!out.is_open()) {
+			std::cout << "warning: can not open " << filename << '\n';
+			return 0;
+		}
+
+		std::vector<Mesh> meshes = products(b);
+		std::mt19937 random(b.seed);
+
+		// defective products, picked at random
+		std::vector<std::size_t> order(meshes.size());
+		for (std::size_t i = 0; i != order.size(); ++i) order[i] = i;
+		std::shuffle(order.begin(), order.end(), random);
+		int num_defects = std::min<int>(b.defects, (int)meshes.size());
+		for (int d = 0; d != num_defects; ++d) add_defect(meshes[order[d]], (Synthetic_Defect)(d % 3));
+
+		out << "# synthetic building: " << b.storeys << " storeys x " << b.rooms << " rooms, "
+			<< meshes.size() << " products" << '\n';
+		out << std::setprecision(15);
+		std::size_t base = 0, num_faces = 0;
+		for (std::size_t product = 0; product != meshes.size(); ++product) {
+			base += write_product(out, product, meshes[product], base, b.jitter, random);
+			num_faces += meshes[product].faces.size();
+		}
+
+		std::cout << "synthetic building: " << b.storeys << " storeys x " << b.rooms << " rooms, " << meshes.size() << " products, "
+			<< base << " vertices, " << num_faces << " faces, " << num_defects << " defects" << '\n';
+		std::cout << "stored in: " << filename << '\n';
+		return meshes.size();
+	}
+};
@@ -0,0 +1,637 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <limits>
+#include <unordered_map>
+#include <cstdint>
+#include <iterator>
+
+#include "json.hpp"
+#include "JsonStream.hpp"
+#include "Polyhedra.hpp"
+#include "Semantics.hpp"
+
+
+
+// cityjson transform -- vertices are written as integers, v = q * CityJSON_Scale + translate
+// translate is the minimum corner of the bounding box, vertices falling in the same grid cell are merged
+const double CityJSON_Scale = 0.001; // 1 mm for a model in metres
+
+// also write the document in a binary encoding (mybuilding.city.cbor / .msgpack), for machine to machine handoff
+enum class Binary_Format { NONE, CBOR, MSGPACK };
+const Binary_Format Binary_Output = Binary_Format::NONE;
+
+// also write a CityJSON text sequence (mybuilding.city.jsonl): a header line, then one CityJSONFeature
+// per first level city object with its own vertices -- the converter writes one building, so one feature
+const bool CityJSONSeq_Enabled = false;
+
+// shells for writing to json 
+struct JShell {
+	Shell_Type type; // EXTERIOR - BuildingPart, ROOM - BuildingRoom
+	std::vector<std::vector<unsigned long>> faces;
+	std::vector<Semantic_Surface> semantics; // semantic for each face of an exterior shell
+};
+
+
+
+class WriteToJSON {
+private:
+	std::vector<Approx_point> vertices; // vertices for writing to city json file
+	std::vector<JShell> jshells; // selected shells for writing to city json file
+	Approx_point translate; // transform of the city json file, set by quantize_vertices
+	std::vector<std::array<long long, 3>> quantized; // integer coordinates of vertices on the grid of the transform
+	bool is_quantized = false; // the faces of jshells index quantized
+
+	// geometry templates of the repeated input shells, see add_template_instances
+	struct Template_instance {
+		std::size_t shell; // 0-based, shell id - 1
+		std::size_t template_index; // in template_faces
+		int rotation; // quarter turns around z of the placement
+		unsigned long reference; // reference point, index in vertices (in quantized once quantized)
+	};
+	std::vector<Approx_point> template_vertices; // "vertices-templates"
+	std::vector<std::vector<std::vector<unsigned long>>> template_faces; // faces of each template, index template_vertices
+	std::vector<Template_instance> template_instances;
+
+	// global vertex pool: grid cell of Epsilon -> index in vertices
+	typedef std::array<long long, 3> Cell;
+	struct Cell_hash {
+		std::size_t operator()(const Cell& c) const {
+			std::size_t h = 0;
+			for (auto const& v : c) h ^= std::hash<long long>()(v) + 0x9e3779b9 + (h << 6) + (h >> 2);
+			return h;
+		}
+	};
+	std::unordered_map<Cell, unsigned long, Cell_hash> pool;
+private:
+	/*
+	* index of a vertex in vertices, the vertex is added if no vertex lies in its grid cell yet
+	* the cells are Epsilon wide, ie vertices closer than Epsilon are taken as the same vertex
+	* (unless a cell border falls between them)
+	*/
+	unsigned long pool_vertex(const Approx_point& vertex) {
+		Cell cell = {
+			std::llround(vertex[0] / Epsilon),
+			std::llround(vertex[1] / Epsilon),
+			std::llround(vertex[2] / Epsilon) };
+		auto it = pool.find(cell);
+		if (it != pool.end()) return it->second;
+
+		unsigned long index = (unsigned long)vertices.size();
+		pool.emplace(cell, index);
+		vertices.push_back(vertex);
+		return index;
+	}
+
+
+public:
+	/*
+	* select the se which is needed to be written to cityjson
+	* add non-repeated vertices to vertices list, through the hashed pool (linear in the number of vertices)
+	* add the correct indices of each face in each shell
+	*
+	* selected shell explorers, by the type given during extraction:
+	* exterior shells first, then the rooms; voids and solids are not written
+	*/
+	void process_shell_explorer_indices(std::vector<Shell_explorer<Policy>>& shell_explorers)
+	{
+		if (is_quantized) {
+			std::cout << "warning: the shells were written already, please use a new WriteToJSON" << '\n';
+			return;
+		}
+
+		std::size_t num_voids = 0;
+		for (Shell_Type type : { Shell_Type::EXTERIOR, Shell_Type::ROOM }) {
+			for (auto const& se : shell_explorers) {
+				if (se.type == Shell_Type::VOID && type == Shell_Type::ROOM) ++num_voids;
+				if (se.type != type) continue;
+
+				// the explorers emit unique vertices, so each vertex of the shell is looked up in the pool once
+				std::vector<unsigned long> pool_index(se.coordinates.size());
+				for (std::size_t i = 0; i != se.coordinates.size(); ++i) {
+					pool_index[i] = pool_vertex(se.coordinates[i]);
+				}
+
+				JShell jshell;
+				jshell.type = type;
+				for (auto const& current_face : se.faces) {
+					jshell.faces.emplace_back();
+					for (auto const& current_index : current_face) {
+						jshell.faces.back().push_back(pool_index[current_index]);
+					}
+				}
+
+				//semantics -- only for BuildingPart's geomery, one semantic for each face
+				if (type == Shell_Type::EXTERIOR) {
+					jshell.semantics = SemanticSurfaces::classify(vertices, jshell.faces);
+				}
+				jshells.push_back(jshell);
+			}
+		}
+		if (num_voids != 0) std::cout << "skip " << num_voids << " void shells" << '\n';
+		if (jshells.empty() || jshells[0].type != Shell_Type::EXTERIOR) {
+			std::cout << "warning: no exterior shell found, please check the extraction" << '\n';
+		}
+
+	}
+
+
+	/*
+	* add the shells repeated in the input as instances of their geometry template
+	* call after process_shell_explorer_indices and before writing, the reference points join the vertex pool
+	* (they would not be quantized once the vertices are)
+	* a shell placed by (rotation, offset) is Rz(-rotation) * (template + offset), so its reference point
+	* is Rz(-rotation) * offset and its transformation matrix the rotation Rz(-rotation)
+	*/
+	void add_template_instances(const Templates& templates) {
+		if (is_quantized) {
+			std::cout << "warning: the vertices are quantized already, please add the template instances before writing" << '\n';
+			return;
+		}
+
+		std::vector<long> template_index(templates.representatives.size(), -1);
+		for (std::size_t t = 0; t != templates.representatives.size(); ++t) {
+			if (templates.instance_counts[t] < 2) continue;
+			template_index[t] = (long)template_faces.size();
+
+			unsigned long first = (unsigned long)template_vertices.size();
+			for (auto const& v : templates.vertices[t]) template_vertices.push_back({ v.x, v.y, v.z });
+			template_faces.emplace_back();
+			for (auto const& face : templates.faces[t]) {
+				template_faces.back().emplace_back();
+				for (auto const& index : face) template_faces.back().back().push_back(first + index);
+			}
+		}
+
+		for (std::size_t shell = 0; shell != templates.placements.size(); ++shell) {
+			if (!GeometryTemplates::is_repeated(templates, shell)) continue;
+			const Template_placement& placement = templates.placements[shell];
+			Vector3d reference = GeometryTemplates::rotate(placement.offset, -placement.rotation);
+			template_instances.push_back({ shell, (std::size_t)template_index[placement.template_id],
+				placement.rotation, pool_vertex({ reference.x, reference.y, reference.z }) });
+		}
+		std::cout << "emit " << template_instances.size() << " instances of " << template_faces.size() << " geometry templates" << '\n';
+	}
+
+
+	/*
+	* write one repeated shell as a BuildingInstallation with a GeometryInstance geometry
+	*/
+	static void write_template_instance(JsonStream& json, const Template_instance& instance) {
+		static const int cosines[4] = { 1, 0, -1, 0 };
+		static const int sines[4] = { 0, 1, 0, -1 };
+		int quarter_turns = ((-instance.rotation) % 4 + 4) % 4;
+		int c = cosines[quarter_turns], s = sines[quarter_turns];
+		int matrix[16] = { c, -s, 0, 0, s, c, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+
+		json.begin_object();
+		json.key("attributes"); json.begin_object(); json.end_object();
+		json.key("geometry");
+		json.begin_array();
+		json.begin_object();
+		json.key("boundaries"); json.begin_array(); json.value(instance.reference); json.end_array();
+		json.key("template"); json.value(instance.template_index);
+		json.key("transformationMatrix");
+		json.begin_array();
+		for (int m : matrix) json.value((double)m);
+		json.end_array();
+		json.key("type"); json.value("GeometryInstance");
+		json.end_object();
+		json.end_array();
+		json.key("parents");
+		json.begin_array();
+		json.value("Building_1");
+		json.end_array();
+		json.key("type"); json.value("BuildingInstallation");
+		json.end_object();
+	}
+
+
+	/*
+	* write the "geometry-templates" member: one MultiSurface per template and the template vertices
+	*/
+	void write_geometry_templates(JsonStream& json) {
+		json.begin_object();
+		json.key("templates");
+		json.begin_array();
+		for (auto const& faces : template_faces) {
+			json.begin_object();
+			json.key("boundaries");
+			json.begin_array();
+			for (auto const& face : faces) {
+				json.begin_array();
+				json.begin_array();
+				for (auto const& index : face) json.value(index);
+				json.end_array();
+				json.end_array();
+			}
+			json.end_array();
+			json.key("lod"); json.value("2.2");
+			json.key("type"); json.value("MultiSurface");
+			json.end_object();
+		}
+		json.end_array();
+		json.key("vertices-templates");
+		json.begin_array();
+		for (auto const& v : template_vertices) {
+			json.begin_array();
+			json.value(v[0]); json.value(v[1]); json.value(v[2]);
+			json.end_array();
+		}
+		json.end_array();
+		json.end_object();
+	}
+
+
+	/*
+	* remap the face indices of a shell after merging vertices, and repair the faces:
+	* repeated consecutive vertices are removed, faces with less than 3 vertices left are dropped with their semantics
+	* return: the number of dropped faces
+	*/
+	static std::size_t remap_faces(JShell& jshell, const std::vector<unsigned long>& new_index) {
+		std::size_t num_dropped = 0;
+		std::vector<std::vector<unsigned long>> faces;
+		std::vector<Semantic_Surface> semantics;
+		for (std::size_t f = 0; f != jshell.faces.size(); ++f) {
+			std::vector<unsigned long> face;
+			for (auto const& index : jshell.faces[f]) {
+				unsigned long q = new_index[index];
+				if (face.empty() || face.back() != q) face.push_back(q);
+			}
+			while (face.size() > 1 && face.front() == face.back()) face.pop_back();
+			if (face.size() < 3) {
+				++num_dropped;
+				continue;
+			}
+			faces.push_back(face);
+			if (!jshell.semantics.empty()) semantics.push_back(jshell.semantics[f]);
+		}
+		jshell.faces = faces;
+		jshell.semantics = semantics;
+		return num_dropped;
+	}
+
+
+	/*
+	* quantize the vertices on the grid of the transform and merge the vertices in the same grid cell
+	* faces are repaired after the merge, see remap_faces
+	*/
+	void quantize_vertices() {
+		if (is_quantized) return;
+		is_quantized = true;
+		translate = { 0.0, 0.0, 0.0 };
+		quantized.clear();
+		if (vertices.empty()) return;
+
+		translate = vertices[0];
+		for (auto const& v : vertices) {
+			for (int c = 0; c != 3; ++c) translate[c] = std::min(translate[c], v[c]);
+		}
+
+		std::map<std::array<long long, 3>, unsigned long> cells; // grid cell -> index in quantized
+		std::vector<unsigned long> new_index(vertices.size());
+		bool overflow = false;
+		for (std::size_t i = 0; i != vertices.size(); ++i) {
+			std::array<long long, 3> q;
+			for (int c = 0; c != 3; ++c) {
+				q[c] = std::llround((vertices[i][c] - translate[c]) / CityJSON_Scale);
+				if (q[c] > std::numeric_limits<int>::max()) overflow = true;
+			}
+			auto it = cells.find(q);
+			if (it == cells.end()) {
+				it = cells.emplace(q, (unsigned long)quantized.size()).first;
+				quantized.push_back(q);
+			}
+			new_index[i] = it->second;
+		}
+		if (overflow) std::cout << "warning: quantized coordinates exceed 32 bit integers, please check CityJSON_Scale" << '\n';
+
+		std::size_t num_dropped = 0;
+		for (auto& jshell : jshells) num_dropped += remap_faces(jshell, new_index);
+		for (auto& instance : template_instances) instance.reference = new_index[instance.reference];
+
+		std::cout << "quantize " << vertices.size() << " vertices to " << quantized.size()
+			<< " vertices on a grid of " << CityJSON_Scale << ", dropped " << num_dropped << " faces" << '\n';
+	}
+
+
+	/*
+	* write one selected shell as a CityObject, a child of Building_1
+	* the type follows the shell type: exterior - BuildingPart, room - BuildingRoom
+	* exterior shells carry the semantics of their faces
+	*/
+	static void write_city_object(JsonStream& json, const JShell& jshell) {
+		json.begin_object();
+		json.key("attributes"); json.begin_object(); json.end_object();
+		json.key("geometry");
+		json.begin_array();
+		json.begin_object();
+
+		// boundaries: one shell, each face is a surface with one ring
+		json.key("boundaries");
+		json.begin_array();
+		json.begin_array();
+		for (auto const& face : jshell.faces) {
+			json.begin_array();
+			json.begin_array();
+			for (auto const& index : face) json.value(index);
+			json.end_array();
+			json.end_array();
+		}
+		json.end_array();
+		json.end_array();
+		json.key("lod"); json.value("2.2");
+
+		//semantics(each face) for BuildingPart geometry
+		if (jshell.type == Shell_Type::EXTERIOR) {
+			json.key("semantics");
+			json.begin_object();
+			json.key("surfaces");
+			json.begin_array();
+			for (const char* surface : { "GroundSurface", "WallSurface", "RoofSurface" }) {
+				json.begin_object();
+				json.key("type"); json.value(surface);
+				json.end_object();
+			}
+			json.end_array();
+			json.key("values");
+			json.begin_array();
+			json.begin_array();
+			for (auto const& surface_type : jshell.semantics) {
+				if (surface_type == SEMANTIC_NONE)json.null(); // Surfaces with no defined types
+				else json.value((int)surface_type);
+			}
+			json.end_array();
+			json.end_array();
+			json.end_object();
+		}
+
+		json.key("type"); json.value("Solid");
+		json.end_object();
+		json.end_array();
+		json.key("parents");
+		json.begin_array();
+		json.value("Building_1");
+		json.end_array();
+		json.key("type"); json.value(jshell.type == Shell_Type::EXTERIOR ? "BuildingPart" : "BuildingRoom");
+		json.end_object();
+	}
+
+
+	/*
+	* write the vertices and selected jshells to city json
+	* the vertices are quantized first, see quantize_vertices
+	* the document is streamed to the file, the keys of each object are written in sorted order
+	* so the output is the same as json.dump(indent) of the equivalent nlohmann::json
+	* indent < 0 - compact
+	*/
+	void write_vertices_shells(std::string& fname, int indent = 2) {
+		Scoped_timer timer("write_vertices_shells");
+		quantize_vertices();
+		Instrumentation::gauge("output.vertices", (double)vertices.size());
+		Instrumentation::gauge("output.shells", (double)jshells.size());
+
+		JsonStream json(OUTPUT_PATH + fname, indent);
+		if (!json.good()) {
+			std::cout << "warning: can not open " << (OUTPUT_PATH + fname) << '\n';
+			return;
+		}
+		write_document(json, indent);
+	}
+
+
+	/*
+	* write the CityObjects member: Building_1 and its children, in sorted order of the ids
+	* one child per selected shell: Building_1_0, Building_1_1, ... (exterior shells first, then the rooms)
+	* and one per repeated input shell: Building_1_installation_<shell id>
+	* shells, instances: jshells and template_instances, or copies of them indexing other vertices
+	* depth: of the CityObjects value in the document, for the indentation of the children
+	*/
+	static void write_city_objects(JsonStream& json, int indent, int depth,
+		const std::vector<JShell>& shells, const std::vector<Template_instance>& instances) {
+		std::vector<std::string> children;
+		for (std::size_t k = 0; k != shells.size(); ++k) {
+			children.push_back("Building_1_" + std::to_string(k));
+		}
+		for (auto const& instance : instances) {
+			children.push_back("Building_1_installation_" + std::to_string(instance.shell + 1));
+		}
+		std::vector<std::size_t> order(children.size()); // children in sorted order of their ids
+		for (std::size_t k = 0; k != order.size(); ++k) order[k] = k;
+		std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) { return children[a] < children[b]; });
+
+		json.begin_object();
+
+		// Building info ---------------------------------------------------------------
+		json.key("Building_1");
+		json.begin_object();
+		json.key("attributes"); json.begin_object(); json.end_object();
+		json.key("children");
+		json.begin_array();
+		for (auto const& child : children) json.value(child);
+		json.end_array();
+		json.key("geometry"); json.begin_array(); json.end_array();
+		json.key("type"); json.value("Building");
+		json.end_object();
+
+		// the CityObjects are independent, each one is serialized into its own buffer in parallel
+		// and the buffers are written in the order of the ids
+		std::vector<std::string> city_objects(children.size());
+		parallel_for(children.size(), [&](std::size_t k) {
+			JsonStream part(indent, depth + 1);
+			if (k < shells.size()) write_city_object(part, shells[k]);
+			else write_template_instance(part, instances[k - shells.size()]);
+			city_objects[k] = part.str();
+		});
+		for (std::size_t k : order) {
+			json.key(children[k]);
+			json.raw(city_objects[k]);
+		}
+		json.end_object();
+	}
+
+
+	/*
+	* write the "transform" member
+	*/
+	void write_transform(JsonStream& json) {
+		json.begin_object();
+		json.key("scale");
+		json.begin_array(); json.value(CityJSON_Scale); json.value(CityJSON_Scale); json.value(CityJSON_Scale); json.end_array();
+		json.key("translate");
+		json.begin_array(); json.value(translate[0]); json.value(translate[1]); json.value(translate[2]); json.end_array();
+		json.end_object();
+	}
+
+
+	/*
+	* write the "vertices" member, as integers on the grid of the transform
+	*/
+	void write_quantized_vertices(JsonStream& json) {
+		json.begin_array();
+		for (auto const& q : quantized) {
+			json.begin_array();
+			json.value(q[0]); json.value(q[1]); json.value(q[2]);
+			json.end_array();
+		}
+		json.end_array();
+	}
+
+
+	/*
+	* write the whole city json document to json, indent as given to json
+	*/
+	void write_document(JsonStream& json, int indent) {
+		quantize_vertices();
+
+		json.begin_object();
+		json.key("CityObjects");
+		write_city_objects(json, indent, 1, jshells, template_instances);
+
+		if (!template_faces.empty()) {
+			json.key("geometry-templates");
+			write_geometry_templates(json);
+		}
+
+		// basic info ---------------------------------------------------------------
+		json.key("transform");
+		write_transform(json);
+		json.key("type"); json.value("CityJSON");
+		json.key("version"); json.value("1.1");
+
+		// all vertices, as integers on the grid of the transform --------------------------------
+		json.key("vertices");
+		write_quantized_vertices(json);
+
+		json.end_object();
+	}
+
+
+	/*
+	* write the document as a CityJSON text sequence: a header line with the transform (and the geometry templates),
+	* then one CityJSONFeature line per first level city object, holding the object, its children and its own vertices
+	* the converter has one first level object, Building_1, complete only once every shell is extracted:
+	* its feature is written after the extraction, like the document
+	* the ids and the transform are the ones of write_vertices_shells
+	*/
+	void write_sequence(std::string& fname) {
+		Scoped_timer timer("write_sequence");
+		quantize_vertices();
+
+		std::ofstream out_stream(OUTPUT_PATH + fname, std::ios::binary);
+		if (!out_stream.good()) {
+			std::cout << "warning: can not open " << (OUTPUT_PATH + fname) << '\n';
+			return;
+		}
+
+		JsonStream header(-1, 0);
+		header.begin_object();
+		header.key("CityObjects"); header.begin_object(); header.end_object();
+		if (!template_faces.empty()) {
+			header.key("geometry-templates");
+			write_geometry_templates(header);
+		}
+		header.key("transform");
+		write_transform(header);
+		header.key("type"); header.value("CityJSON");
+		header.key("version"); header.value("1.1");
+		header.key("vertices"); header.begin_array(); header.end_array();
+		header.end_object();
+		out_stream << header.str() << '\n';
+
+		// Building_1 --------------------------------------------------------------------
+		// the vertices of the feature are the quantized vertices its objects use, indexed from 0 in the order of first use
+		std::vector<long> local_index(quantized.size(), -1);
+		std::vector<unsigned long> feature_vertices; // index in quantized of each vertex of the feature
+		auto local_vertex = [&](unsigned long index) {
+			if (local_index[index] < 0) {
+				local_index[index] = (long)feature_vertices.size();
+				feature_vertices.push_back(index);
+			}
+			return (unsigned long)local_index[index];
+		};
+		std::vector<JShell> shells = jshells;
+		for (auto& jshell : shells) {
+			for (auto& face : jshell.faces) {
+				for (auto& index : face) index = local_vertex(index);
+			}
+		}
+		std::vector<Template_instance> instances = template_instances;
+		for (auto& instance : instances) instance.reference = local_vertex(instance.reference);
+
+		JsonStream feature(-1, 0);
+		feature.begin_object();
+		feature.key("CityObjects");
+		write_city_objects(feature, -1, 1, shells, instances);
+		feature.key("id"); feature.value("Building_1");
+		feature.key("type"); feature.value("CityJSONFeature");
+		feature.key("vertices");
+		feature.begin_array();
+		for (auto const& index : feature_vertices) {
+			feature.begin_array();
+			feature.value(quantized[index][0]); feature.value(quantized[index][1]); feature.value(quantized[index][2]);
+			feature.end_array();
+		}
+		feature.end_array();
+		feature.end_object();
+		out_stream << feature.str() << '\n';
+	}
+
+
+
+
+	/*
+	* the city json document as an nlohmann::json, from the same writer as the text file
+	*/
+	nlohmann::json to_json() {
+		JsonStream text(-1, 0);
+		write_document(text, -1);
+		return nlohmann::json::parse(text.str());
+	}
+
+
+	/*
+	* write the city json document as CBOR or MessagePack, the same model as the text file
+	*/
+	void write_binary(std::string& fname, Binary_Format format) {
+		std::vector<std::uint8_t> bytes = encode(to_json(), format);
+		std::ofstream out_stream(OUTPUT_PATH + fname, std::ios::binary);
+		if (!out_stream.good()) {
+			std::cout << "warning: can not open " << (OUTPUT_PATH + fname) << '\n';
+			return;
+		}
+		out_stream.write((const char*)bytes.data(), (std::streamsize)bytes.size());
+	}
+
+
+	/*
+	* read a binary city json file back, eg for a round trip check against the text file
+	* return: null if the file can not be opened or decoded
+	*/
+	static nlohmann::json read_binary(std::string& fname, Binary_Format format) {
+		std::ifstream in_stream(OUTPUT_PATH + fname, std::ios::binary);
+		if (!in_stream.is_open()) {
+			std::cout << "warning: can not open " << (OUTPUT_PATH + fname) << '\n';
+			return nlohmann::json();
+		}
+		std::vector<std::uint8_t> bytes((std::istreambuf_iterator<char>(in_stream)), std::istreambuf_iterator<char>());
+		try {
+			return decode(bytes, format);
+		}
+		catch (const nlohmann::json::parse_error& e) {
+			std::cout << "warning: can not decode " << (OUTPUT_PATH + fname) << ": " << e.what() << '\n';
+			return nlohmann::json();
+		}
+	}
+
+
+	static std::vector<std::uint8_t> encode(const nlohmann::json& json, Binary_Format format) {
+		return format == Binary_Format::CBOR ? nlohmann::json::to_cbor(json) : nlohmann::json::to_msgpack(json);
+	}
+
+
+	static nlohmann::json decode(const std::vector<std::uint8_t>& bytes, Binary_Format format) {
+		return format == Binary_Format::CBOR ? nlohmann::json::from_cbor(bytes) : nlohmann::json::from_msgpack(bytes);
+	}
+};
@@ -1,392 +1,92 @@
 ﻿#include <iostream>
 #include <fstream>
+#include <chrono>
+#include <type_traits>
 
-#include "json.hpp"
 #include "Polyhedra.hpp"
+#include "IfcReader.hpp"
+#include "WriteToJSON.hpp"
+#include "SyntheticOBJ.hpp"
+#include "Regression.hpp"
 
 
 
-// shells for writing to json 
-struct JShell {
-	std::vector<std::vector<unsigned long>> faces;
-	std::vector<std::string> semantics; // semantic for each face in jshells[0] - exterior shell
-};
+// input of the conversion: KIT.obj written by IfcConvert, or the building elements read from KIT.ifc directly,
+// or a synthetic building written by SyntheticOBJ as synthetic.obj
+// BIMConvertToGeo --check obj|synthetic runs the regression check on KIT.obj or the synthetic building instead, see check()
+enum class Input_Format { OBJ, IFC, SYNTHETIC };
+const Input_Format Input = Input_Format::OBJ;
+const Synthetic_building Synthetic_Input(2, 4); // storeys, rooms
+const std::string Synthetic_Folder = "/synthetic"; // subfolder of the intermediate folder for the files of the synthetic input
+const std::string Ifc_Folder = "/ifc"; // subfolder of the intermediate folder for the files of the ifc input
+const std::string Golden_Filename = "/golden/mybuilding.city.json"; // in the output folder, the reference of check(), never written
 
 
 
-class WriteToJSON {
-private:
-	std::vector<Point> vertices; // vertices for writing to city json file
-	std::vector<JShell> jshells; // selected shells for writing to city json file
-private:
-	/*
-	* check if a vertex already exists in a vertices vector
-	* USE coordinates to compare whether two vertices are the same
-	* return: False - not exist, True - exist
-	*/
-	bool vertex_exist_check(std::vector<Point>& vertices, Point& vertex) {
-		bool flag(false);
-		for (auto& v : vertices) {
-			if (
-				abs(CGAL::to_double(vertex.x()) - CGAL::to_double(v.x())) < Epsilon &&
-				abs(CGAL::to_double(vertex.y()) - CGAL::to_double(v.y())) < Epsilon &&
-				abs(CGAL::to_double(vertex.z()) - CGAL::to_double(v.z())) < Epsilon) {
-
-				flag = true;
-			}
-		}
-		return flag;
-	}
-
-
-	/*
-	* if a vertex is repeated, find the index and return
-	*/
-	unsigned long find_vertex(std::vector<Point>& vertices, Point& vertex) {
-		for (std::size_t i = 0; i != vertices.size(); ++i) {
-			if (
-				abs(CGAL::to_double(vertex.x()) - CGAL::to_double(vertices[i].x())) < Epsilon &&
-				abs(CGAL::to_double(vertex.y()) - CGAL::to_double(vertices[i].y())) < Epsilon &&
-				abs(CGAL::to_double(vertex.z()) - CGAL::to_double(vertices[i].z())) < Epsilon) {
-
-				return (unsigned long)i;
-			}
-		}
-		std::cout << "warning: please check find_vertex function" << '\n';
-		return 0;
-	}
-
-
-	/*
-	* get the semantics of a face in jshells[0] - exterior
-	*/
-	std::string get_semantics_for_face_in_exterior(std::vector<unsigned long>& face) {
-		if (face.empty()) {
-			std::cout << "no semantics for the face, please check" << '\n';
-			return "null";
-		}
-
-		return "null";
-
-	}
-public:
-	/*
-	* select the se which is needed to be written to cityjson
-	* add non-repeated vertices to vertices list
-	* add the correct indices of each face in each shell
-	*
-	* selected shell explorer:
-	* shell_explorers[0] - exterior
-	* shell_explorers[3] - room 1
-	* shell_explorers[4] - room 2
-	* shell_explorers[5] - room 3
-	* shell_explorers[6] - room 4
-	*/
-	void process_shell_explorer_indices(std::vector<Shell_explorer>& shell_explorers)
-	{
-		// first store all the vertices in a vector
-		std::vector<Point> all_vertices; // contains repeated vertices
-		for (auto const& se : shell_explorers) {
-			for (auto const& v : se.vertices) {
-				all_vertices.push_back(v);
-			}
-		}
-
-		// next store the face indexes(accumulated from 0)	
-		unsigned long index_in_all_vertices = 0;
-		for (auto& se : shell_explorers) {
-			for (auto& face : se.faces) {
-				for (auto& index : face) {
-					index = index_in_all_vertices++;
-				}
-			}
-		}
-		// now we have the all_vertices and shell_explorers to write to cityjson -----------------------------
-
-
-		// clear the repeated vertices, add them to vertices(param), add the selected shells to shells(param)
-		unsigned long index_in_vertices = 0; // accumulated index
-
-		// exterior -----------------------------------------
-		auto const& se_0 = shell_explorers[0];
-		JShell jshell_0; // corresponds to se_0
-		for (auto const& current_face : se_0.faces) {
-			jshell_0.faces.emplace_back();
-			for (auto const& current_index : current_face) {
-				Point& vertex = all_vertices[current_index];
-				if (!vertex_exist_check(vertices, vertex)) {
-					vertices.push_back(vertex);
-					jshell_0.faces.back().push_back(index_in_vertices++);
-				}
-				else {
-					unsigned long exist_vertex_index = find_vertex(vertices, vertex);
-					jshell_0.faces.back().push_back(exist_vertex_index);
-				}
-			}
-
-			//semantics -- only for BuildingPart's geomery
-			jshell_0.semantics.emplace_back(); //one semantic for each face
-			jshell_0.semantics.back() = get_semantics_for_face_in_exterior(jshell_0.faces.back());
-		}
-		jshells.push_back(jshell_0);
-
-		// shell_explorers[3] - room 1 ------------------------
-		auto const& se_3 = shell_explorers[3];
-		JShell jshell_1; // corresponds to se_1
-		for (auto const& current_face : se_3.faces) {
-			jshell_1.faces.emplace_back();
-			for (auto const& current_index : current_face) {
-				Point& vertex = all_vertices[current_index];
-				if (!vertex_exist_check(vertices, vertex)) {
-					vertices.push_back(vertex);
-					jshell_1.faces.back().push_back(index_in_vertices++); // index_in_vertices defined at first
-				}
-				else {
-					unsigned long exist_vertex_index = find_vertex(vertices, vertex);
-					jshell_1.faces.back().push_back(exist_vertex_index);
-				}
-			}
-		}
-		jshells.push_back(jshell_1);
-
-		// shell_explorers[4] - room 2 ------------------------
-		auto const& se_4 = shell_explorers[4];
-		JShell jshell_2; // corresponds to se_4
-		for (auto const& current_face : se_4.faces) {
-			jshell_2.faces.emplace_back();
-			for (auto const& current_index : current_face) {
-				Point& vertex = all_vertices[current_index];
-				if (!vertex_exist_check(vertices, vertex)) {
-					vertices.push_back(vertex);
-					jshell_2.faces.back().push_back(index_in_vertices++); // index_in_vertices defined at first
-				}
-				else {
-					unsigned long exist_vertex_index = find_vertex(vertices, vertex);
-					jshell_2.faces.back().push_back(exist_vertex_index);
-				}
-			}
-		}
-		jshells.push_back(jshell_2);
-
-		// shell_explorers[5] - room 3 ------------------------
-		auto const& se_5 = shell_explorers[5];
-		JShell jshell_3; // corresponds to se_5
-		for (auto const& current_face : se_5.faces) {
-			jshell_3.faces.emplace_back();
-			for (auto const& current_index : current_face) {
-				Point& vertex = all_vertices[current_index];
-				if (!vertex_exist_check(vertices, vertex)) {
-					vertices.push_back(vertex);
-					jshell_3.faces.back().push_back(index_in_vertices++); // index_in_vertices defined at first
-				}
-				else {
-					unsigned long exist_vertex_index = find_vertex(vertices, vertex);
-					jshell_3.faces.back().push_back(exist_vertex_index);
-				}
-			}
-		}
-		jshells.push_back(jshell_3);
-
-		// shell_explorers[6] - room 4 ------------------------
-		auto const& se_6 = shell_explorers[6];
-		JShell jshell_4; // corresponds to se_6
-		for (auto const& current_face : se_6.faces) {
-			jshell_4.faces.emplace_back();
-			for (auto const& current_index : current_face) {
-				Point& vertex = all_vertices[current_index];
-				if (!vertex_exist_check(vertices, vertex)) {
-					vertices.push_back(vertex);
-					jshell_4.faces.back().push_back(index_in_vertices++); // index_in_vertices defined at first
-				}
-				else {
-					unsigned long exist_vertex_index = find_vertex(vertices, vertex);
-					jshell_4.faces.back().push_back(exist_vertex_index);
-				}
-			}
-		}
-		jshells.push_back(jshell_4);
-
+/*
+* convert input to the city json file OUTPUT_PATH + filename
+*/
+static void convert(Input_Format input, std::string filename)
+{
+	std::cout << "-- activated data folder: " << DATA_PATH << '\n';
+	std::cout << "-- exact kernel: " << Policy::name() << '\n';
+	Instrumentation::label("kernel", Policy::name());
+	Instrumentation::label("input", input == Input_Format::IFC ? "ifc" : (input == Input_Format::SYNTHETIC ? "synthetic" : "obj"));
+	Instrumentation::label("extraction", Extraction_Method == Extraction_Mode::SURFACE_MESH ? "surface mesh" : "visitor");
+	Instrumentation::label("snap_rounding", Snap_Enabled ? "on" : "off");
+	if (std::is_same<Policy, Homogeneous_integer_policy>::value && !Snap_Enabled) {
+		std::cout << "warning: the homogeneous kernel works best with snap rounding enabled" << '\n';
 	}
-
-
-	/*
-	* write the vertices and selected jshells to city json
-	*/
-	void write_vertices_shells(std::string& fname) {
-		// basic info ---------------------------------------------------------------
-		nlohmann::json json;
-		json["type"] = "CityJSON";
-		json["version"] = "1.1";
-		json["transform"] = nlohmann::json::object();
-		json["transform"]["scale"] = nlohmann::json::array({ 1.0, 1.0, 1.0 });
-		json["transform"]["translate"] = nlohmann::json::array({ 0.0, 0.0, 0.0 });
-		json["vertices"] = nlohmann::json::array({}); // vertices
-
-		// all vertices(including repeated vertices)-----------------------------------		
-		for (auto const& v : vertices) {
-			double x = CGAL::to_double(v.x()); // warning: may have precision loss
-			double y = CGAL::to_double(v.y());
-			double z = CGAL::to_double(v.z());
-			json["vertices"].push_back({ x, y, z });
-		}
-
-		// Building info ---------------------------------------------------------------
-		json["CityObjects"] = nlohmann::json::object();
-		json["CityObjects"]["Building_1"]["type"] = "Building";
-		json["CityObjects"]["Building_1"]["attributes"] = nlohmann::json({});
-		json["CityObjects"]["Building_1"]["children"]
-			= nlohmann::json::array({ "Building_1_0", "Building_1_1", "Building_1_2", "Building_1_3", "Building_1_4" });
-		json["CityObjects"]["Building_1"]["geometry"] = nlohmann::json::array({});
-
-		// BuildingPart - exterior ------------------------------------------------------
-		json["CityObjects"]["Building_1_0"]["type"] = "BuildingPart";
-		json["CityObjects"]["Building_1_0"]["attributes"] = nlohmann::json({});
-		json["CityObjects"]["Building_1_0"]["parents"] = nlohmann::json::array({ "Building_1" });
-		json["CityObjects"]["Building_1_0"]["geometry"] = nlohmann::json::array();
-		json["CityObjects"]["Building_1_0"]["geometry"][0]["type"] = "Solid";
-		json["CityObjects"]["Building_1_0"]["geometry"][0]["lod"] = "2.2";
-		json["CityObjects"]["Building_1_0"]["geometry"][0]["boundaries"] = nlohmann::json::array({}); // indices	
-		
-		//semantics for BuildingPart geometry
-		auto& g = json["CityObjects"]["Building_1_0"]["geometry"];
-		g[0]["semantics"] = nlohmann::json({});
-		auto& sem = g[0]["semantics"];
-		sem["surfaces"][0]["type"] = "GroundSurface";
-		sem["surfaces"][1]["type"] = "WallSurface";
-		sem["surfaces"][2]["type"] = "RoofSurface";
-		sem["values"] = nlohmann::json::array({});
-
-		//boundaries and semantics(each face) for BuildingPart geometry
-		auto& b_BuildingPart = json["CityObjects"]["Building_1_0"]["geometry"][0]["boundaries"][0];
-		auto const& jshell_exterior = jshells[0];
-		for (auto const& face : jshell_exterior.faces) {
-			b_BuildingPart.push_back({ face });
-		}
-		auto semantics = nlohmann::json::array({}); // add corresponding index(int or null) of semantics
-		for (std::size_t i = 0; i != jshell_exterior.faces.size(); ++i) {
-			if (i == 0 || i == 1 || i == 2 || i == 3 || i == 4 ||
-				i == 5 || i == 6 || i == 7 || i == 8 ||
-				i == 9 || i == 10 || i == 11 || i == 12 ||
-				i == 13 || i == 15 || i == 17 || i == 18 ||
-				i == 20)semantics.push_back(1); // WallSurfaces
-			else if (i == 14) {
-				semantics.push_back(0); // GroundSurface
-			}
-			else if(i == 25 || i == 26){
-				semantics.push_back(2); // RoofSurfaces
-			}
-			else{
-				semantics.push_back(nullptr); // Surfaces with no defined types
-			}
-		}
-		sem["values"].push_back(semantics); // add the json array to semantics - values
-		/*for (auto const& surface_type : jshell_exterior.semantics) {
-			if (surface_type == "GroundSurface")semantics.push_back(0);
-			else if (surface_type == "WallSurface")semantics.push_back(1);
-			else if (surface_type == "RoofSurface")semantics.push_back(2);
-			else if (surface_type == "null")semantics.push_back(nullptr);
-		}*/
-		
-
-		// BuildingRoom 1 - shell_explorers[3] -------------------------------------------
-		json["CityObjects"]["Building_1_1"]["type"] = "BuildingRoom";
-		json["CityObjects"]["Building_1_1"]["attributes"] = nlohmann::json({});
-		json["CityObjects"]["Building_1_1"]["parents"] = nlohmann::json::array({ "Building_1" });
-		json["CityObjects"]["Building_1_1"]["geometry"] = nlohmann::json::array();
-		json["CityObjects"]["Building_1_1"]["geometry"][0]["type"] = "Solid";
-		json["CityObjects"]["Building_1_1"]["geometry"][0]["lod"] = "2.2";
-		json["CityObjects"]["Building_1_1"]["geometry"][0]["boundaries"] = nlohmann::json::array({}); // indices
-		auto& b_BuildingRoom1 = json["CityObjects"]["Building_1_1"]["geometry"][0]["boundaries"][0];
-		auto const& jshell_room_1 = jshells[1];
-		for (auto const& face : jshell_room_1.faces) {
-			b_BuildingRoom1.push_back({ face });
-		}
-
-		// BuildingRoom 2 - shell_explorers[4] -------------------------------------------
-		json["CityObjects"]["Building_1_2"]["type"] = "BuildingRoom";
-		json["CityObjects"]["Building_1_2"]["attributes"] = nlohmann::json({});
-		json["CityObjects"]["Building_1_2"]["parents"] = nlohmann::json::array({ "Building_1" });
-		json["CityObjects"]["Building_1_2"]["geometry"] = nlohmann::json::array();
-		json["CityObjects"]["Building_1_2"]["geometry"][0]["type"] = "Solid";
-		json["CityObjects"]["Building_1_2"]["geometry"][0]["lod"] = "2.2";
-		json["CityObjects"]["Building_1_2"]["geometry"][0]["boundaries"] = nlohmann::json::array({}); // indices
-		auto& b_BuildingRoom2 = json["CityObjects"]["Building_1_2"]["geometry"][0]["boundaries"][0];
-		auto const& jshell_room_2 = jshells[2];
-		for (auto const& face : jshell_room_2.faces) {
-			b_BuildingRoom2.push_back({ face });
-		}
-
-		// BuildingRoom 3 - shell_explorers[5] -------------------------------------------
-		json["CityObjects"]["Building_1_3"]["type"] = "BuildingRoom";
-		json["CityObjects"]["Building_1_3"]["attributes"] = nlohmann::json({});
-		json["CityObjects"]["Building_1_3"]["parents"] = nlohmann::json::array({ "Building_1" });
-		json["CityObjects"]["Building_1_3"]["geometry"] = nlohmann::json::array();
-		json["CityObjects"]["Building_1_3"]["geometry"][0]["type"] = "Solid";
-		json["CityObjects"]["Building_1_3"]["geometry"][0]["lod"] = "2.2";
-		json["CityObjects"]["Building_1_3"]["geometry"][0]["boundaries"] = nlohmann::json::array({}); // indices
-		auto& b_BuildingRoom3 = json["CityObjects"]["Building_1_3"]["geometry"][0]["boundaries"][0];
-		auto const& jshell_room_3 = jshells[3];
-		for (auto const& face : jshell_room_3.faces) {
-			b_BuildingRoom3.push_back({ face });
-		}
-
-		// BuildingRoom 4 - shell_explorers[6] -------------------------------------------
-		json["CityObjects"]["Building_1_4"]["type"] = "BuildingRoom";
-		json["CityObjects"]["Building_1_4"]["attributes"] = nlohmann::json({});
-		json["CityObjects"]["Building_1_4"]["parents"] = nlohmann::json::array({ "Building_1" });
-		json["CityObjects"]["Building_1_4"]["geometry"] = nlohmann::json::array();
-		json["CityObjects"]["Building_1_4"]["geometry"][0]["type"] = "Solid";
-		json["CityObjects"]["Building_1_4"]["geometry"][0]["lod"] = "2.2";
-		json["CityObjects"]["Building_1_4"]["geometry"][0]["boundaries"] = nlohmann::json::array({}); // indices
-		auto& b_BuildingRoom4 = json["CityObjects"]["Building_1_4"]["geometry"][0]["boundaries"][0];
-		auto const& jshell_room_4 = jshells[4];
-		for (auto const& face : jshell_room_4.faces) {
-			b_BuildingRoom4.push_back({ face });
-		}
-
-		// write to file
-		std::string json_string = json.dump(2);
-		std::ofstream out_stream(OUTPUT_PATH + fname);
-		out_stream << json_string;
-		out_stream.close();
-
+	if (Templates_Enabled && !Snap_Enabled) {
+		std::cout << "warning: Templates_Enabled needs snap rounding, every shell is built on its own" << '\n';
 	}
 
-
-};
-
-
-
-int main()
-{	
-	std::cout << "-- activated data folder: " << DATA_PATH << '\n';
-
 	// clear the repeated vertices and decompose to OBJ files ----------------------------------------------------------
 
 	OBJFile f; // organize vertcies, faces, shells and objects
+	std::vector<Ifc_product> ifc_extrusions; // products built by Build_Nef_Extrusion, with the ifc input
 	
 	std::cout << '\n';
-	std::string fname = "/KIT.obj";
-	LoadOBJ::load_obj(fname, f);
+	if (input == Input_Format::IFC) {
+		std::string fname = "/KIT.ifc";
+		LoadIFC::load_ifc(fname, f, Ifc_Element_Types, Ifc_Extrusion_Fast_Path ? &ifc_extrusions : nullptr);
+	}
+	else if (input == Input_Format::SYNTHETIC) {
+		std::string fname = "/synthetic.obj";
+		SyntheticOBJ::write(fname, Synthetic_Input);
+		LoadOBJ::load_obj(fname, f);
+	}
+	else {
+		std::string fname = "/KIT.obj";
+		LoadOBJ::load_obj(fname, f);
+	}
+
+	// the intermediate files of KIT.obj are part of the data, the other inputs write their own to a subfolder
+	std::string inter_folder = input == Input_Format::SYNTHETIC ? Synthetic_Folder : (input == Input_Format::IFC ? Ifc_Folder : "");
 
 	std::cout << '\n';
-	std::string repeated_info_name = "/KIT.repeated.vertices.txt";
+	std::string repeated_info_name = inter_folder + "/KIT.repeated.vertices.txt";
 	LoadOBJ::repeated_vertices_info(repeated_info_name, f);
 
 	std::cout << '\n';
-	std::string repeated_faces_name = "/KIT.repeated.faces.txt";
+	std::string repeated_faces_name = inter_folder + "/KIT.repeated.faces.txt";
 	LoadOBJ::repeated_faces_info(repeated_faces_name, f);
 
 	std::cout << '\n';
-	std::string new_vertices_name = "/KIT.new.vertices.txt";
+	std::string new_vertices_name = inter_folder + "/KIT.new.vertices.txt";
 	LoadOBJ::process_repeated_vertices(new_vertices_name, f);
 
 	std::cout << '\n';
-	std::string new_faces_name = "/KIT.new.faces.txt";
+	std::string new_faces_name = inter_folder + "/KIT.new.faces.txt";
 	LoadOBJ::process_repeated_faces(new_faces_name, f);
 
+	if (Snap_Enabled) {
+		std::cout << '\n';
+		SnapRounding::snap_vertices(f); // round the welded vertices to the lattice, repair degenerated faces
+	}
+
 	std::cout << '\n';
-	std::string output_obj_name = "/KIT.output.obj";
+	std::string output_obj_name = inter_folder + "/KIT.output.obj";
 	LoadOBJ::output_obj(output_obj_name, f);
 
 	/* 
@@ -395,40 +95,52 @@ int main()
 	* shell.faces -> face.v_poly_indices -- store the indices(0-based) point to the shell.poly_vertices 
 	*/
 	PreparePolyhedron::prepare_poly_vertices_face_indices(f); // uncomment this to output each shell
-	PreparePolyhedron::output_each_shell(f); // uncomment this to output each shell
+	PreparePolyhedron::output_each_shell(f, inter_folder); // uncomment this to output each shell
+
+	// group the repeated shells into geometry templates
+	Templates templates;
+	if (Templates_Enabled || Templates_Emit) {
+		std::cout << '\n';
+		GeometryTemplates::detect(f, templates);
+	}
 
 	std::cout << '\n';
 
 	// Build nef polyhedra and extract geometries --------------------------------------------------------------------
 	
-	Nef nef;
+	Nef<Policy> nef;
 
 	std::cout << "building nef polyhedra..." << '\n';
-	Build_Nef_Polyhedron::build_nef_polyhedra(nef); // build Nef_polyhedra according to different shells, add the nef polyhedra to nef list
+	auto nef_start = std::chrono::steady_clock::now();
+	if (input == Input_Format::IFC) {
+		Build_Nef_Polyhedron<Policy>::build_nef_polyhedra_each_shell(nef, (int)f.shells.size(), &templates, inter_folder);
+		Build_Nef_Extrusion<Policy>::build_nef_polyhedra(nef, ifc_extrusions);
+	}
+	else if (input == Input_Format::SYNTHETIC) {
+		Build_Nef_Polyhedron<Policy>::build_nef_polyhedra_each_shell(nef, (int)f.shells.size(), &templates, inter_folder);
+	}
+	else {
+		Build_Nef_Polyhedron<Policy>::build_nef_polyhedra(nef, &templates); // build Nef_polyhedra according to different shells, add the nef polyhedra to nef list
+	}
+
+	// close tiny gaps between the elements before the union
+	if (Offset_Enabled) GapOffset<Policy>::offset_nef_polyhedra(nef.nef_polyhedron_list);
 
 	// build big Nef
-	BigNef::test_big(nef);
+	BigNef<Policy>::test_big(nef);
+	BigNef<Policy>::regularize(nef); // drop the lower dimensional leftovers of the union
+	std::chrono::duration<double> nef_time = std::chrono::steady_clock::now() - nef_start;
+	std::cout << "building and union of nef polyhedra took: " << nef_time.count() << " s" << " (snap rounding: " << (Snap_Enabled ? "on" : "off") << ")" << '\n';
 
 	
 	// extract geometries ------------------------------------------------------------
-	std::vector<Shell_explorer> shell_explorers;
-	
-	int volume_count = 0;
-	int shell_count = 0;
-	Nef_polyhedron::Volume_const_iterator current_volume;
-	CGAL_forall_volumes(current_volume, nef.big_nef) {
-		std::cout << "volume: " << volume_count++ << " ";
-		std::cout << "volume mark: " << current_volume->mark() << '\n';
-		Nef_polyhedron::Shell_entry_const_iterator current_shell;
-		CGAL_forall_shells_of(current_shell, current_volume) {
-			Shell_explorer se;
-			Nef_polyhedron::SFace_const_handle sface_in_shell(current_shell);
-			nef.big_nef.visit_shell_objects(sface_in_shell, se);
-
-			//add the se to shell_explorers
-			shell_explorers.push_back(se);
-		}
-	}
+	std::vector<Shell_explorer<Policy>> shell_explorers;
+
+	auto extract_start = std::chrono::steady_clock::now();
+	ExtractGeometries<Policy>::extract(nef, shell_explorers);
+	std::chrono::duration<double> extract_time = std::chrono::steady_clock::now() - extract_start;
+	std::cout << "extracting geometries took: " << extract_time.count() << " s" << " (extraction: "
+		<< (Extraction_Method == Extraction_Mode::SURFACE_MESH ? "surface mesh" : "visitor") << ")" << '\n';
 
 
 	std::cout << "after extracting geometries: " << '\n';
@@ -442,12 +154,76 @@ int main()
 
 
 	//process the indices and write to json file----------------------------------------
-	std::string filename = "/mybuilding.city.json";
 	WriteToJSON w;
 	w.process_shell_explorer_indices(shell_explorers);
+	if (Templates_Emit) w.add_template_instances(templates);
 	w.write_vertices_shells(filename);
 	std::cout << "city json file stored in: " << (OUTPUT_PATH + filename) << '\n';
 
+	if (CityJSONSeq_Enabled) {
+		std::string seq_filename = "/mybuilding.city.jsonl";
+		w.write_sequence(seq_filename);
+		std::cout << "city json sequence stored in: " << (OUTPUT_PATH + seq_filename) << '\n';
+	}
+
+	if (Binary_Output != Binary_Format::NONE) {
+		std::string binary_filename = Binary_Output == Binary_Format::CBOR ? "/mybuilding.city.cbor" : "/mybuilding.city.msgpack";
+		w.write_binary(binary_filename, Binary_Output);
+		bool same = WriteToJSON::read_binary(binary_filename, Binary_Output) == w.to_json();
+		std::cout << "binary city json file stored in: " << (OUTPUT_PATH + binary_filename)
+			<< " (round trip: " << (same ? "ok" : "differs") << ")" << '\n';
+	}
+
+}
+
+
+/*
+* regression check of one input, run by ctest (see CMakeLists.txt) in its own process: the peak rss held to
+* Regression_Memory_Budget is the high water mark of the process, a second run in the same process would be hidden by the first
+* obj: KIT.obj against the golden file Golden_Filename, synthetic: the synthetic building against its known volumes
+* the output is written to *.check.city.json, the golden file is only read
+* return: True - all checks passed
+*/
+static bool check(Input_Format input)
+{
+	std::string filename = input == Input_Format::SYNTHETIC ? "/synthetic.check.city.json" : "/mybuilding.check.city.json";
+	convert(input, filename);
+
+	std::cout << '\n';
+	bool passed = Regression::check_budgets();
+	nlohmann::json output = Regression::read_city_json(filename);
+	if (input == Input_Format::SYNTHETIC) {
+		passed = Regression::check_synthetic(output, Synthetic_Input) && passed;
+	}
+	else {
+		passed = Regression::check_golden(output, Regression::read_city_json(Golden_Filename)) && passed;
+	}
+	std::cout << '\n' << "regression check " << (passed ? "passed" : "FAILED") << '\n';
+	return passed;
+}
+
+
+
+int main(int argc, char* argv[])
+{
+	if (argc > 1 && std::string(argv[1]) == "--check") {
+		std::string which = argc > 2 ? argv[2] : "";
+		if (which != "obj" && which != "synthetic") {
+			std::cout << "usage: BIMConvertToGeo --check obj|synthetic" << '\n';
+			return 1;
+		}
+		return check(which == "synthetic" ? Input_Format::SYNTHETIC : Input_Format::OBJ) ? 0 : 1;
+	}
+
+	std::string filename = "/mybuilding.city.json";
+	convert(Input, filename);
+
+	// time of each stage, sizes and peak memory of the run
+	std::string report_filename = "/mybuilding.report.json";
+	if (Instrumentation::write_report(report_filename)) {
+		std::cout << "report stored in: " << (OUTPUT_PATH + report_filename) << " (peak rss: "
+			<< Instrumentation::peak_rss() / (1024 * 1024) << " MB)" << '\n';
+	}
 
 	return 0;
 }